@@ -0,0 +1,303 @@
+/*
+* Copyright (C) 2021 Duowan Inc. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+// benchmark of encode/decode, need c++11
+// usage: bench [-t seconds] [filter]   filter matches "format/dataset/op", e.g. json/wide
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include "xpack/json.h"
+#include "xpack/xml.h"
+#ifdef XPACK_BENCH_YAML
+#include "xpack/yaml.h"
+#endif
+#ifdef XPACK_BENCH_BSON
+#include "xpack/bson.h"
+#endif
+
+using namespace std;
+
+// ++++++++++++++++++ allocation counter ++++++++++++++++++
+// noinline, or gcc will see new paired with free and warn
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+static size_t g_allocs = 0;
+
+BENCH_NOINLINE void* operator new(size_t size) {
+    ++g_allocs;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (NULL == p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+BENCH_NOINLINE void operator delete(void *p) noexcept {
+    free(p);
+}
+BENCH_NOINLINE void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+// ++++++++++++++++++ datasets ++++++++++++++++++
+// wide struct
+struct Wide {
+    int i1, i2, i3, i4, i5, i6, i7, i8;
+    int64_t l1, l2, l3, l4;
+    double d1, d2, d3, d4;
+    bool b1, b2, b3, b4;
+    string s1, s2, s3, s4, s5, s6, s7, s8;
+    XPACK(O(i1, i2, i3, i4, i5, i6, i7, i8, l1, l2, l3, l4, d1, d2, d3, d4, b1, b2, b3, b4, s1, s2, s3, s4, s5, s6, s7, s8));
+};
+struct WideSet {
+    vector<Wide> items;
+    XPACK(O(items));
+};
+
+// deep nesting
+struct Deep {
+    int level;
+    string name;
+    vector<Deep> child;
+    XPACK(O(level, name, child));
+};
+struct DeepSet {
+    vector<Deep> trees;
+    XPACK(O(trees));
+};
+
+// large arrays
+struct Arrays {
+    vector<int> ints;
+    vector<double> doubles;
+    vector<string> names;
+    XPACK(O(ints, doubles, names));
+};
+
+// string heavy
+struct Text {
+    string title;
+    string body;
+    map<string, string> tags;
+    XPACK(O(title, body, tags));
+};
+struct TextSet {
+    vector<Text> docs;
+    XPACK(O(docs));
+};
+
+// numeric heavy
+struct Point {
+    int64_t id;
+    double x;
+    double y;
+    float z;
+    unsigned int flag;
+    XPACK(O(id, x, y, z, flag));
+};
+struct PointSet {
+    vector<Point> points;
+    XPACK(O(points));
+};
+
+static string make_string(size_t i, size_t len) {
+    static const char chs[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    string s;
+    s.reserve(len);
+    for (size_t j=0; j<len; ++j) {
+        s += chs[(i*31+j*7)%(sizeof(chs)-1)];
+    }
+    return s;
+}
+
+static void make(WideSet &ws, size_t num) {
+    ws.items.resize(num);
+    for (size_t i=0; i<num; ++i) {
+        Wide &w = ws.items[i];
+        w.i1 = (int)i; w.i2 = -(int)i; w.i3 = (int)(i*7); w.i4 = (int)(i%100);
+        w.i5 = 1<<20; w.i6 = 0; w.i7 = (int)(i*i); w.i8 = -1;
+        w.l1 = (int64_t)i<<32; w.l2 = -(int64_t)i*1000003; w.l3 = 1234567890123LL; w.l4 = (int64_t)i;
+        w.d1 = i*0.5; w.d2 = 3.141592653589793; w.d3 = -1e-10*i; w.d4 = 1e300;
+        w.b1 = true; w.b2 = false; w.b3 = i%2==0; w.b4 = i%3==0;
+        w.s1 = make_string(i, 8); w.s2 = make_string(i+1, 16); w.s3 = make_string(i+2, 4); w.s4 = "";
+        w.s5 = make_string(i+3, 32); w.s6 = "name"; w.s7 = make_string(i+4, 12); w.s8 = make_string(i+5, 24);
+    }
+}
+
+static void make(Deep &d, int level, int depth) {
+    d.level = level;
+    d.name = make_string((size_t)level, 10);
+    if (level < depth) {
+        d.child.resize(1);
+        make(d.child[0], level+1, depth);
+    }
+}
+static void make(DeepSet &ds, size_t num) {
+    ds.trees.resize(num);
+    for (size_t i=0; i<num; ++i) {
+        make(ds.trees[i], 0, 32);
+    }
+}
+
+static void make(Arrays &a, size_t num) {
+    for (size_t i=0; i<num; ++i) {
+        a.ints.push_back((int)(i*2654435761U));
+        a.doubles.push_back(i/7.0);
+        a.names.push_back(make_string(i, 6));
+    }
+}
+
+static void make(TextSet &ts, size_t num) {
+    ts.docs.resize(num);
+    for (size_t i=0; i<num; ++i) {
+        Text &t = ts.docs[i];
+        t.title = make_string(i, 40);
+        t.body = make_string(i, 2000) + "<tag attr=\"v\">'&'</tag>\n\ttab \\ slash";
+        for (size_t j=0; j<8; ++j) {
+            t.tags["tag"+make_string(j, 4)] = make_string(i+j, 20);
+        }
+    }
+}
+
+static void make(PointSet &ps, size_t num) {
+    ps.points.resize(num);
+    for (size_t i=0; i<num; ++i) {
+        Point &p = ps.points[i];
+        p.id = (int64_t)i*1000000007LL;
+        p.x = i*0.001;
+        p.y = -1.0/(double)(i+1);
+        p.z = (float)i/3;
+        p.flag = (unsigned int)i;
+    }
+}
+
+// ++++++++++++++++++ runner ++++++++++++++++++
+static double g_seconds = 0.3;
+static const char *g_filter = NULL;
+
+struct Result {
+    size_t ops;
+    double seconds;
+    size_t allocs;
+};
+
+template <class F>
+static Result run(F f) {
+    f(); // warm up
+
+    Result r = {0, 0, 0};
+    size_t allocs = g_allocs;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    do {
+        f();
+        ++r.ops;
+        r.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (r.seconds < g_seconds);
+    r.allocs = g_allocs - allocs;
+    return r;
+}
+
+static void report(const string &name, size_t bytes, size_t objects, const Result &r) {
+    double mb = (double)bytes*r.ops/(1024*1024);
+    printf("%-28s %10zu %10.2f %14.0f %12.1f\n", name.c_str(), bytes, mb/r.seconds,
+           (double)objects*r.ops/r.seconds, (double)r.allocs/r.ops);
+}
+
+template <class T, class Enc, class Dec>
+static void bench(const string &format, const string &dataset, const T &val, size_t objects, Enc enc, Dec dec) {
+    string en = format+"/"+dataset+"/encode";
+    string de = format+"/"+dataset+"/decode";
+    bool doen = NULL==g_filter || en.find(g_filter)!=string::npos;
+    bool dode = NULL==g_filter || de.find(g_filter)!=string::npos;
+    if (!doen && !dode) {
+        return;
+    }
+
+    string data = enc(val);
+    if (doen) {
+        Result r = run([&]() { string s = enc(val); });
+        report(en, data.size(), objects, r);
+    }
+    if (dode) {
+        Result r = run([&]() { T t; dec(data, t); });
+        report(de, data.size(), objects, r);
+    }
+}
+
+template <class T>
+static void bench_all(const string &dataset, const T &val, size_t objects) {
+    bench("json", dataset, val, objects,
+        [](const T &v) { return xpack::json::encode(v); },
+        [](const string &s, T &v) { xpack::json::decode(s, v); });
+    bench("xml", dataset, val, objects,
+        [](const T &v) { return xpack::xml::encode(v, "root"); },
+        [](const string &s, T &v) { xpack::xml::decode(s, v); });
+    bench("xmlstream", dataset, val, objects,
+        [](const T &v) { xpack::XmlEncoder en; en.SetStream(true); return en.encode(v, "root"); },
+        [](const string &s, T &v) { xpack::xml::decode(s, v); });
+#ifdef XPACK_BENCH_YAML
+    bench("yaml", dataset, val, objects,
+        [](const T &v) { return xpack::yaml::encode(v); },
+        [](const string &s, T &v) { xpack::yaml::decode(s, v); });
+#endif
+#ifdef XPACK_BENCH_BSON
+    bench("bson", dataset, val, objects,
+        [](const T &v) { return xpack::bson::encode(v); },
+        [](const string &s, T &v) { xpack::bson::decode(s, v); });
+#endif
+}
+
+int main(int argc, char *argv[]) {
+    for (int i=1; i<argc; ++i) {
+        if (0 == strcmp(argv[i], "-t") && i+1 < argc) {
+            g_seconds = atof(argv[++i]);
+        } else {
+            g_filter = argv[i];
+        }
+    }
+
+    printf("%-28s %10s %10s %14s %12s\n", "case", "bytes", "MB/s", "objects/s", "allocs/op");
+
+    WideSet ws;
+    make(ws, 200);
+    bench_all("wide", ws, ws.items.size());
+
+    DeepSet ds;
+    make(ds, 20);
+    bench_all("deep", ds, ds.trees.size()*33);
+
+    Arrays as;
+    make(as, 20000);
+    bench_all("array", as, as.ints.size());
+
+    TextSet ts;
+    make(ts, 50);
+    bench_all("string", ts, ts.docs.size());
+
+    PointSet ps;
+    make(ps, 5000);
+    bench_all("numeric", ps, ps.points.size());
+
+    return 0;
+}
@@ -19,6 +19,7 @@
 
 #include "bson_decoder.h"
 #include "bson_encoder.h"
+#include "bson_reader.h"
 #include "xpack.h"
 
 #ifdef X_PACK_SUPPORT_CXX0X // support c++11 or later
@@ -32,20 +33,47 @@ class bson {
 public:
     template <class T>
     static void decode(const std::string &data, T &val) {
+        X_PACK_INSTRUMENT_BYTES(DECODE, T, data.size())
         BsonDecoder de;
         de.decode(data, val);
     }
 
     template <class T>
     static void decode(const uint8_t* data, size_t len, T &val) {
+        X_PACK_INSTRUMENT_BYTES(DECODE, T, len)
         BsonDecoder de;
         de.decode(data, len, val);
     }
 
+    // decode every document of concatenated bson(e.g. .bson file of mongodump) and call f(T&) for each, return the count
+    template <class T, class F>
+    static size_t for_each(const std::string &file_name, F f) {
+        BsonReader reader(file_name);
+        return for_each<T>(reader, f);
+    }
+    // fd is read till the end, not closed
+    template <class T, class F>
+    static size_t for_each(int fd, F f) {
+        BsonReader reader(fd);
+        return for_each<T>(reader, f);
+    }
+    template <class T, class F>
+    static size_t for_each(const uint8_t* data, size_t len, F f) {
+        X_PACK_INSTRUMENT_BYTES(DECODE, T, len)
+        BsonReader reader(data, len);
+        return for_each<T>(reader, f);
+    }
+    template <class T, class F>
+    static size_t for_each(BsonReader &reader, F f) {
+        return decode_each<T>(reader, f);
+    }
+
     template <class T>
     static std::string encode(const T &val) {
         BsonEncoder en;
-        return en.encode(val);
+        std::string s = en.encode(val);
+        X_PACK_INSTRUMENT_BYTES(ENCODE, T, s.size())
+        return s;
     }
 };
 
@@ -18,12 +18,20 @@
 #define __X_PACK_BSON_BUILDER_H
 
 #include <stdexcept>
+#include <map>
+#include <memory>
+#include <mutex>
 #include "bson_encoder.h"
 
 #ifndef X_PACK_SUPPORT_CXX0X // support c++11 or later
 #error "need c++11 or later"
 #endif
 
+// max number of formats cached by BsonBuilder::En
+#ifndef X_PACK_BSON_BUILDER_CACHE_SIZE
+#define X_PACK_BSON_BUILDER_CACHE_SIZE 1024
+#endif
+
 namespace xpack {
 
 class BsonBuilder {
@@ -170,7 +178,9 @@ public:
         BsonBuilder bd(*this);
         bd.iencode(args...);
         bd.end(NULL);
-        return bd.en->en.String();
+        std::string ret;
+        bd.en->wr.Take(ret);
+        return ret;
     }
 
     template <typename... Args>
@@ -185,13 +195,40 @@ public:
 
         return bd.en->wr.Json();
     }
+    // same as BsonBuilder(fmt).Encode(args...), but the parsed fmt is cached, so each fmt is parsed once
     template <typename... Args>
     static std::string En(const std::string&fmt, Args... args) {
-        BsonBuilder bb(fmt);
-        return bb.Encode(args...);
+        std::unique_ptr<BsonBuilder> tmp;
+        return Cached(fmt, tmp)->Encode(args...);
+    }
+
+private:
+    // builder of fmt in the process wide cache. if the cache is full, a new one is returned and owned by tmp
+    static BsonBuilder* Cached(const std::string&fmt, std::unique_ptr<BsonBuilder>&tmp) {
+        static std::mutex lock;
+        static std::map<std::string, std::unique_ptr<BsonBuilder> > cache;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            std::map<std::string, std::unique_ptr<BsonBuilder> >::const_iterator it = cache.find(fmt);
+            if (it != cache.end()) {
+                return it->second.get();
+            }
+        }
+
+        tmp.reset(new BsonBuilder(fmt)); // parse out of the lock
+        std::lock_guard<std::mutex> guard(lock);
+        if (cache.size() >= X_PACK_BSON_BUILDER_CACHE_SIZE) {
+            return tmp.get();
+        }
+        // another thread may have inserted it, then tmp is dropped
+        std::map<std::string, std::unique_ptr<BsonBuilder> >::iterator it = cache.insert(std::make_pair(fmt, std::unique_ptr<BsonBuilder>())).first;
+        if (!it->second) {
+            it->second.reset(tmp.release());
+        }
+        return it->second.get();
     }
 
-private: // encoder
+    // encoder
     BsonBuilder(const BsonBuilder&bd):dup(NULL) {
         en = new Encoder(bd.items);
     }
@@ -27,15 +27,21 @@
 namespace xpack {
 
 
+/*
+  the document is walked with bson_iter_t, nothing is indexed.
+  a node keeps the iterator of its value and a cursor over its children. keys are
+  searched from the last found one, so fields in declaration order cost one step each.
+*/
 class BsonNode {
     typedef XDecoder<BsonNode> decoder;
     friend class BsonDecoder;
 public:
     typedef size_t Iterator;
 
-    BsonNode(const bson_iter_t* iter = NULL):it(iter),inited(false) {
-        if (NULL != it) {
-            type = bson_iter_type(it);
+    BsonNode(const bson_iter_t* iter = NULL):valid(NULL!=iter),top(false),pos(0) {
+        if (valid) {
+            it = *iter;
+            type = bson_iter_type(&it);
         }
     }
 
@@ -43,65 +49,85 @@ public:
         return "bson";
     }
     operator bool () const {
-        return it != NULL;
+        return valid;
     }
     bool IsNull() const {
-        return NULL!=it && BSON_TYPE_NULL==bson_iter_type(it);
+        return valid && BSON_TYPE_NULL==type;
     }
     BsonNode Find(decoder&de, const char*key, const Extend *ext) {
-        (void)de;
         (void)ext;
 
-        if (!inited) {
-            this->init();
-        }
-
         if (BSON_TYPE_DOCUMENT != type) {
             de.decode_exception("not document", NULL);
         }
 
-        node_index::iterator iter = _childs_index.find(key);
-        if (iter != _childs_index.end()) {
-            return BsonNode(&_childs[iter->second]);
-        } else {
-            return BsonNode();
+        if (0 == pos) {
+            this->begin(cursor);
+        }
+        bson_iter_t t = cursor;
+        const char *last = (pos>0) ? bson_iter_key(&cursor) : NULL; // stop here after wrapped
+        bool wrapped = (NULL == last);
+        for (;;) {
+            if (!bson_iter_next(&t)) {
+                if (wrapped) {
+                    break;
+                }
+                wrapped = true;
+                this->begin(t);
+                continue;
+            }
+            const char *k = bson_iter_key(&t);
+            if (0 == strcmp(k, key)) {
+                cursor = t;
+                pos = 1;
+                return BsonNode(&t);
+            } else if (k == last) {
+                break;
+            }
         }
+        return BsonNode();
     }
     size_t Size(decoder&de) {
-        (void)de;
-        if (!inited) {
-            this->init();
-        }
-
-        if (BSON_TYPE_ARRAY == type) {
-            return _childs.size();
-        } else {
+        if (BSON_TYPE_ARRAY != type) {
             de.decode_exception("not array", NULL);
             return 0;
         }
+
+        size_t size = 0;
+        bson_iter_t t;
+        this->begin(t);
+        while (bson_iter_next(&t)) {
+            ++size;
+        }
+        return size;
     }
-    BsonNode At(size_t index) const { // no exception
-        return BsonNode(&(_childs[index]));
+    BsonNode At(size_t index) const { // no exception. elements are visited in order, so step the cursor
+        if (0 == pos || index+1 < pos) {
+            this->begin(cursor);
+            pos = 0;
+        }
+        for (; pos <= index; ++pos) {
+            bson_iter_next(&cursor);
+        }
+        return BsonNode(&cursor);
     }
     BsonNode Next(decoder&de, BsonNode&p, Iterator&iter, std::string&key) {
-        (void)de;
-        if (!p.inited) {
-            p.init();
-        }
         if (BSON_TYPE_DOCUMENT != p.type) {
             de.decode_exception("not document", NULL);
         }
 
-        if (it != p.it) {
+        bson_iter_t t;
+        if (this != &p) {
+            t = it;
             ++iter;
         } else {
+            p.begin(t);
             iter = 0;
         }
 
-        if (iter != p._childs.size()) {
-            bson_iter_t *t = &p._childs[iter];
-            key = bson_iter_key(t);
-            return BsonNode(t);
+        if (bson_iter_next(&t)) {
+            key = bson_iter_key(&t);
+            return BsonNode(&t);
         }
 
         return BsonNode();
@@ -112,9 +138,9 @@ public:
 
         if (BSON_TYPE_UTF8 == type) {
             uint32_t length;
-            const char* data = bson_iter_utf8(it, &length);
+            const char* data = bson_iter_utf8(&it, &length);
             if (NULL != data) {
-                val = std::string(data, length);
+                val.assign(data, length); // keep the capacity of val
             }
         } else if (BSON_TYPE_NULL != type) {
             de.decode_exception("not string", NULL);
@@ -124,21 +150,21 @@ public:
     bool Get(decoder&de, bool &val, const Extend*ext) {
         (void)de;
         (void)ext;
-        val = bson_iter_as_bool(it);
+        val = bson_iter_as_bool(&it);
         return true;
     }
     template <class T>
     typename x_enable_if<numeric<T>::is_integer, bool>::type Get(decoder&de, T &val, const Extend*ext){
         (void)de;
         (void)ext;
-        val = (T)bson_iter_as_int64(it);
+        val = (T)bson_iter_as_int64(&it);
         return true;
     }
     template <class T>
     typename x_enable_if<numeric<T>::is_float, bool>::type Get(decoder&de, T &val, const Extend*ext){
         (void)de;
         (void)ext;
-        val = (T)bson_iter_double(it);
+        val = (T)bson_iter_double(&it);
         return true;
     }
 
@@ -164,7 +190,7 @@ public:
     // bson type
     bool decode_type_spec(bson_oid_t &val, const Extend *ext) {
         (void)ext;
-        const bson_oid_t *t = bson_iter_oid(it);
+        const bson_oid_t *t = bson_iter_oid(&it);
         if (t != NULL) {
             bson_oid_init_from_data(&val, t->bytes);
             return true;
@@ -174,22 +200,22 @@ public:
     }
     bool decode_type_spec(bson_date_time_t &val, const Extend *ext) {
         (void)ext;
-        val.ts = bson_iter_date_time(it);
+        val.ts = bson_iter_date_time(&it);
         return true;
     }
     bool decode_type_spec(bson_timestamp_t &val, const Extend *ext) {
         (void)ext;
-        bson_iter_timestamp(it, &val.timestamp, &val.increment);
+        bson_iter_timestamp(&it, &val.timestamp, &val.increment);
         return true;
     }
     bool decode_type_spec(bson_decimal128_t &val, const Extend *ext) {
         (void)ext;
-        return bson_iter_decimal128(it, &val);
+        return bson_iter_decimal128(&it, &val);
     }
     bool decode_type_spec(bson_regex_t &val, const Extend *ext) {
         (void)ext;
         const char *options = NULL;
-        const char *regex = bson_iter_regex(it, &options);
+        const char *regex = bson_iter_regex(&it, &options);
         if (NULL != regex) {
             val.pattern = regex;
         }
@@ -198,11 +224,32 @@ public:
         }
         return true;
     }
+    bool decode_type_spec(bson_utf8_view_t &val, const Extend *ext) {
+        (void)ext;
+        if (BSON_TYPE_UTF8 == type) {
+            uint32_t length;
+            val.data = bson_iter_utf8(&it, &length);
+            val.length = (NULL != val.data) ? length : 0;
+            return true;
+        }
+        return BSON_TYPE_NULL == type;
+    }
+    bool decode_type_spec(bson_binary_view_t &val, const Extend *ext) {
+        (void)ext;
+        if (BSON_TYPE_BINARY == type) {
+            uint32_t len = 0;
+            val.data = NULL;
+            bson_iter_binary(&it, &val.subType, &len, &val.data);
+            val.length = (NULL != val.data) ? len : 0;
+            return true;
+        }
+        return BSON_TYPE_NULL == type;
+    }
     bool decode_type_spec(bson_binary_t &val, const Extend *ext) {
         (void)ext;
         uint32_t len = 0;
         const uint8_t *data = NULL;
-        bson_iter_binary(it, &val.subType, &len, &data);
+        bson_iter_binary(&it, &val.subType, &len, &data);
         if (data != NULL && len > 0) {
             val.data = std::string((const char*)data, size_t(len));
         }
@@ -211,36 +258,21 @@ public:
 
 
 private:
-    typedef std::map<const char*, size_t, cmp_str> node_index; // index of _childs
-
-    // get object or array info
-    void init(bool top = false) {
-        inited = true;
-
-        bson_iter_t sub;
-        if (NULL != it) {
-            if (top) {
-                type = BSON_TYPE_DOCUMENT;
-                memcpy((void*)&sub, (void*)it, sizeof(sub));
-            } else if (!bson_iter_recurse(it, &sub)) {
-                return;
-            }
-
-            size_t i = 0;
-            while (bson_iter_next(&sub)) {
-                _childs.push_back(sub);
-                if (type == BSON_TYPE_DOCUMENT) {
-                    _childs_index[bson_iter_key(&sub)] = i++;
-                }
-            }
+    // iterator before the first child
+    void begin(bson_iter_t &sub) const {
+        if (top) {
+            sub = it;
+        } else if (!bson_iter_recurse(&it, &sub)) {
+            memset((void*)&sub, 0, sizeof(sub));
         }
     }
 
-    const bson_iter_t* it;
+    bson_iter_t it;             // value of this node. for top node, iterator before the first child
     bson_type_t type;
-    bool inited;
-    std::vector<bson_iter_t> _childs;  // childs
-    node_index _childs_index;
+    bool valid;
+    bool top;
+    mutable bson_iter_t cursor; // last child visited by Find/At
+    mutable size_t pos;         // 0: cursor not started. array: index of cursor+1
 };
 
 
@@ -257,7 +289,8 @@ public:
         bson_iter_init(&it, &b);
 
         BsonNode node(&it);
-        node.init(true);
+        node.type = BSON_TYPE_DOCUMENT;
+        node.top = true;
         return XDecoder<BsonNode>(NULL, (const char*)NULL, node).decode(val, NULL);
     }
 
@@ -273,6 +306,8 @@ template<>struct is_xpack_type_spec<BsonNode, bson_timestamp_t> {static bool con
 template<>struct is_xpack_type_spec<BsonNode, bson_decimal128_t> {static bool const value = true;};
 template<>struct is_xpack_type_spec<BsonNode, bson_binary_t> {static bool const value = true;};
 template<>struct is_xpack_type_spec<BsonNode, bson_regex_t> {static bool const value = true;};
+template<>struct is_xpack_type_spec<BsonNode, bson_utf8_view_t> {static bool const value = true;};
+template<>struct is_xpack_type_spec<BsonNode, bson_binary_view_t> {static bool const value = true;};
 
 }
 
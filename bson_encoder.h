@@ -26,63 +26,70 @@
 
 namespace xpack {
 
+// "0" ~ "999", used as the key of array element
+#define X_PACK_BSON_KEY10(p) p"0", p"1", p"2", p"3", p"4", p"5", p"6", p"7", p"8", p"9"
+#define X_PACK_BSON_KEY100(p) X_PACK_BSON_KEY10(p"0"), X_PACK_BSON_KEY10(p"1"), X_PACK_BSON_KEY10(p"2"), X_PACK_BSON_KEY10(p"3"), X_PACK_BSON_KEY10(p"4"),\
+    X_PACK_BSON_KEY10(p"5"), X_PACK_BSON_KEY10(p"6"), X_PACK_BSON_KEY10(p"7"), X_PACK_BSON_KEY10(p"8"), X_PACK_BSON_KEY10(p"9")
+
+/*
+  write bson into one contiguous buffer. the length of document is reserved
+  at begin and filled at end, no bson_t is used.
+*/
 class BsonWriter: private noncopyable {
     friend class BsonBuilder;
-    struct Node {
-        const char *key;
-        Node    *parent;
-        bson_t data;
-        
-        Node(const char *_key = NULL, Node *_parent=NULL):key(_key), parent(_parent) {
-            if (NULL == parent) {
-                bson_init(&data);
-            }
-        }
-        ~Node() {
-            if (NULL == parent) {
-                bson_destroy(&data);
-            }
-        }
-    };
     friend class XEncoder<BsonWriter>;
     friend class BsonEncoder;
     const static bool support_null = true;
 public:
-    BsonWriter() {
-        cur = new Node(NULL, NULL);
-        nodes.push_back(cur);
+    BsonWriter(size_t reserve = 0) {
+        _buf.reserve(reserve > 5 ? reserve : 5);
+        this->begin();
     }
 
     ~BsonWriter() {
-        std::list<Node*>::iterator it;
-        for (it = nodes.begin(); it!=nodes.end(); ++it) {
-            delete *it;
-        }
     }
 private:
     inline static const char *Name() {
         return "bson";
     }
+    // valid until next IndexKey, the key is copied to buffer at once
     inline const char *IndexKey(size_t index) {
-        if (index > indexStr.size()+1) {
-            std::string s = Util::itoa(index);
-            errCase.push_back(s);
-            return errCase.back().c_str();
+        static const char *const keys[] = {
+            X_PACK_BSON_KEY10(""),
+            X_PACK_BSON_KEY10("1"), X_PACK_BSON_KEY10("2"), X_PACK_BSON_KEY10("3"), X_PACK_BSON_KEY10("4"),
+            X_PACK_BSON_KEY10("5"), X_PACK_BSON_KEY10("6"), X_PACK_BSON_KEY10("7"), X_PACK_BSON_KEY10("8"), X_PACK_BSON_KEY10("9"),
+            X_PACK_BSON_KEY100("1"), X_PACK_BSON_KEY100("2"), X_PACK_BSON_KEY100("3"), X_PACK_BSON_KEY100("4"),
+            X_PACK_BSON_KEY100("5"), X_PACK_BSON_KEY100("6"), X_PACK_BSON_KEY100("7"), X_PACK_BSON_KEY100("8"), X_PACK_BSON_KEY100("9")
+        };
+        if (index < sizeof(keys)/sizeof(keys[0])) {
+            return keys[index];
         }
-        if (index >= indexStr.size()) {
-            std::string s = Util::itoa(index);
-            indexStr.push_back(s);
-        }
-        return indexStr[index].c_str();
+        *Util::itoa(index, _index) = '\0';
+        return _index;
     }
     // return bson binary data
     std::string String() const {
-        return std::string((const char*)bson_get_data(&cur->data), cur->data.len);
+        std::string ret;
+        ret.reserve(_buf.length()+1);
+        ret.append(_buf);
+        ret.push_back('\0');
+        set32(&ret[0], (uint32_t)ret.length());
+        return ret;
+    }
+    // same as String, but close the top document in place and move the buffer out. the writer is done then
+    void Take(std::string &out) {
+        _buf.push_back('\0');
+        set32(&_buf[0], (uint32_t)_buf.length());
+        out.swap(_buf);
     }
     // return json format string
     std::string Json() const {
+        std::string data = this->String();
+        bson_t b;
+        bson_init_static(&b, (const uint8_t*)data.data(), data.length());
+
         size_t len;
-        char *jstr = bson_as_json(&cur->data, &len);
+        char *jstr = bson_as_json(&b, &len);
         std::string ret(jstr);
         bson_free(jstr);
 
@@ -92,63 +99,56 @@ private:
     void ArrayBegin(const char *key, const Extend *ext) {
         (void)ext;
         if (key != NULL) {
-            Node *tmp = new Node(key, cur);
-            nodes.push_back(tmp);
-
-            bson_append_array_begin(&cur->data, key, strlen(key), &tmp->data);
-            cur = tmp;
+            this->element(BSON_TYPE_ARRAY, key);
+            this->begin();
         }
     }
     void ArrayEnd(const char *key, const Extend *ext) {
         (void)ext;
         if (NULL != key) {
-            bson_append_array_end(&cur->parent->data, &cur->data);
-            cur = cur->parent; // do not pop and delete
+            this->end();
         }
     }
     void ObjectBegin(const char *key, const Extend *ext) {
         (void)ext;
         if (key != NULL) {
-            Node *tmp = new Node(key, cur);
-            nodes.push_back(tmp);
-
-            bson_append_document_begin(&cur->data, key, strlen(key), &tmp->data);
-            cur = tmp;
+            this->element(BSON_TYPE_DOCUMENT, key);
+            this->begin();
         }
     }
     void ObjectEnd(const char *key, const Extend *ext) {
         (void)ext;
         if (NULL != key) { // in case of inherit, object key is NULL
-            bson_append_document_end(&cur->parent->data, &cur->data);
-            cur = cur->parent; // do not pop and delete
+            this->end();
         }
     }
     bool WriteNull(const char*key, const Extend *ext) {
         (void)ext;
-        bson_append_null(&cur->data, key, strlen(key));
+        this->element(BSON_TYPE_NULL, key);
         return true;
     }
     bool encode_bool(const char*key, const bool &val, const Extend *ext) {
         (void)ext;
-        bson_append_bool(&cur->data, key, strlen(key), val);
+        this->element(BSON_TYPE_BOOL, key);
+        _buf.push_back(val ? 1 : 0);
         return true;
     }
     bool encode_string(const char*key, const char*val, size_t length, const Extend *ext) {
         (void)ext;
-        bson_append_utf8(&cur->data, key, strlen(key), val, length);
+        this->utf8(key, val, length);
         return true;
     }
     bool encode_string(const char*key, const std::string& val, const Extend *ext) {
         (void)ext;
-        bson_append_utf8(&cur->data, key, strlen(key), (const char*)val.data(), val.length());
+        this->utf8(key, val.data(), val.length());
         return true;
     }
     bool encode_string(const char*key, const char* val, const Extend *ext) {
         (void)ext;
         if (NULL != val) {
-            bson_append_utf8(&cur->data, key, strlen(key), val, strlen(val));
+            this->utf8(key, val, strlen(val));
         } else {
-            bson_append_utf8(&cur->data, key, strlen(key), "", 0);
+            this->utf8(key, "", 0);
         }
         return true;
     }
@@ -156,7 +156,7 @@ private:
     #define X_PACK_BSON_ENCODE_NUMBER(vtype, ftype, ctype) \
     inline bool encode_number(const char*key, const vtype&val, const Extend*ext) {\
         (void)ext;\
-        bson_append_##ftype(&cur->data, key, strlen(key), (vtype)val);\
+        this->encode_##ftype(key, (ctype)val);\
         return true; \
     }
     X_PACK_BSON_ENCODE_NUMBER(char, int32, int32_t)
@@ -179,59 +179,172 @@ private:
     // bson types
     bool encode_type_spec(const char*key, const bson_oid_t &val, const Extend *ext) {
         (void)ext;
-        bson_append_oid(&cur->data, key, strlen(key), &val);
+        this->element(BSON_TYPE_OID, key);
+        _buf.append((const char*)val.bytes, sizeof(val.bytes));
         return true;
     }
     bool encode_type_spec(const char*key, const bson_date_time_t &val, const Extend *ext) {
         (void)ext;
-        bson_append_date_time(&cur->data, key, strlen(key), val.ts);
+        this->element(BSON_TYPE_DATE_TIME, key);
+        this->put64((uint64_t)val.ts);
         return true;
     }
     bool encode_type_spec(const char *key, const bson_timestamp_t &val, const Extend *ext) {
         (void)ext;
-        bson_append_timestamp(&cur->data, key, strlen(key), val.timestamp, val.increment);
+        this->element(BSON_TYPE_TIMESTAMP, key);
+        this->put64(((uint64_t)val.timestamp<<32) | val.increment);
         return true;
     }
     bool encode_type_spec(const char *key, const bson_decimal128_t &val, const Extend *ext) {
         (void)ext;
-        return bson_append_decimal128(&cur->data, key, strlen(key), &val);
+        this->element(BSON_TYPE_DECIMAL128, key);
+        this->put64(val.low);
+        this->put64(val.high);
+        return true;
     }
     bool encode_type_spec(const char *key, const bson_regex_t &val, const Extend *ext) {
         (void)ext;
-        return bson_append_regex(&cur->data, key, strlen(key), val.pattern.c_str(), val.options.c_str());
+        this->element(BSON_TYPE_REGEX, key);
+        _buf.append(val.pattern.c_str(), strlen(val.pattern.c_str())+1);
+        const char *opts = "ilmsux"; // same as libbson, options are sorted and unknown ones are dropped
+        for (; *opts != '\0'; ++opts) {
+            if (NULL != strchr(val.options.c_str(), *opts)) {
+                _buf.push_back(*opts);
+            }
+        }
+        _buf.push_back('\0');
+        return true;
     }
     bool encode_type_spec(const char *key, const bson_binary_t &val, const Extend *ext) {
         (void)ext;
-        return bson_append_binary(&cur->data, key, strlen(key), val.subType, (const uint8_t*)val.data.data(), val.data.length());
+        this->binary(key, val.subType, val.data.data(), val.data.length());
+        return true;
+    }
+    bool encode_type_spec(const char *key, const bson_utf8_view_t &val, const Extend *ext) {
+        (void)ext;
+        this->utf8(key, (NULL != val.data) ? val.data : "", val.length);
+        return true;
+    }
+    bool encode_type_spec(const char *key, const bson_binary_view_t &val, const Extend *ext) {
+        (void)ext;
+        this->binary(key, val.subType, (const char*)val.data, val.length);
+        return true;
     }
 
 private:
-    std::vector<std::string> indexStr;
-    std::list<std::string> errCase;
-    std::list<Node*> nodes;
-    Node *cur;
+    void encode_int32(const char *key, int32_t val) {
+        this->element(BSON_TYPE_INT32, key);
+        this->put32((uint32_t)val);
+    }
+    void encode_int64(const char *key, int64_t val) {
+        this->element(BSON_TYPE_INT64, key);
+        this->put64((uint64_t)val);
+    }
+    void encode_double(const char *key, double val) {
+        uint64_t u;
+        memcpy((void*)&u, (const void*)&val, sizeof(u));
+        this->element(BSON_TYPE_DOUBLE, key);
+        this->put64(u);
+    }
+    void utf8(const char *key, const char *val, size_t length) {
+        this->element(BSON_TYPE_UTF8, key);
+        this->put32((uint32_t)length+1);
+        _buf.append(val, length);
+        _buf.push_back('\0');
+    }
+
+    void binary(const char *key, bson_subtype_t subType, const char *data, size_t length) {
+        uint32_t len = (uint32_t)length;
+        this->element(BSON_TYPE_BINARY, key);
+        if (BSON_SUBTYPE_BINARY_DEPRECATED != subType) {
+            this->put32(len);
+            _buf.push_back((char)subType);
+        } else { // old binary has an inner length
+            this->put32(len+4);
+            _buf.push_back((char)subType);
+            this->put32(len);
+        }
+        _buf.append(data, length);
+    }
+
+    // type, key and \0
+    void element(bson_type_t type, const char *key) {
+        _buf.push_back((char)type);
+        if (NULL != key) {
+            _buf.append(key, strlen(key)+1);
+        } else {
+            _buf.push_back('\0');
+        }
+    }
+    void begin() {
+        _docs.push_back(_buf.length());
+        _buf.append(4, '\0');
+    }
+    void end() {
+        _buf.push_back('\0');
+        size_t start = _docs.back();
+        _docs.pop_back();
+        set32(&_buf[start], (uint32_t)(_buf.length()-start));
+    }
+
+    // little endian
+    void put32(uint32_t v) {
+        char b[4];
+        set32(b, v);
+        _buf.append(b, sizeof(b));
+    }
+    void put64(uint64_t v) {
+        char b[8];
+        set32(b, (uint32_t)v);
+        set32(b+4, (uint32_t)(v>>32));
+        _buf.append(b, sizeof(b));
+    }
+    static void set32(char *p, uint32_t v) {
+        p[0] = (char)v;
+        p[1] = (char)(v>>8);
+        p[2] = (char)(v>>16);
+        p[3] = (char)(v>>24);
+    }
+
+    std::string _buf;           // the top document is closed in String()
+    std::vector<size_t> _docs;  // offset of opening documents
+    char _index[24];
 };
 
 class BsonEncoder {
 public:
-    BsonEncoder() {
+    BsonEncoder():reserve(256) {
+    }
+
+    // initial capacity of the buffer. it grows to the largest result of this encoder
+    BsonEncoder& SetReserve(size_t size) {
+        reserve = size;
+        return *this;
     }
 
     template <class T>
     std::string encode(const T&val) {
-        BsonWriter wr;
+        BsonWriter wr(reserve);
         XEncoder<BsonWriter> en(wr);
         en.encode(NULL, val, NULL);
-        return wr.String();
+        if (wr._buf.length() >= reserve) {
+            reserve = wr._buf.length()+1;
+        }
+        std::string ret;
+        wr.Take(ret);
+        return ret;
     }
 
     template <class T>
     std::string encode_as_json(const T&val) {
-        BsonWriter wr;
+        BsonWriter wr(reserve);
         XEncoder<BsonWriter> en(wr);
         en.encode(NULL, val, NULL);
         return wr.Json();
     }
+
+private:
+    size_t reserve;
 };
 
 template<>struct is_xpack_type_spec<BsonWriter, bson_oid_t> {static bool const value = true;};
@@ -240,6 +353,8 @@ template<>struct is_xpack_type_spec<BsonWriter, bson_timestamp_t> {static bool c
 template<>struct is_xpack_type_spec<BsonWriter, bson_decimal128_t> {static bool const value = true;};
 template<>struct is_xpack_type_spec<BsonWriter, bson_binary_t> {static bool const value = true;};
 template<>struct is_xpack_type_spec<BsonWriter, bson_regex_t> {static bool const value = true;};
+template<>struct is_xpack_type_spec<BsonWriter, bson_utf8_view_t> {static bool const value = true;};
+template<>struct is_xpack_type_spec<BsonWriter, bson_binary_view_t> {static bool const value = true;};
 
 }
 
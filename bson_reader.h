@@ -0,0 +1,214 @@
+/*
+* Copyright (C) 2021 Duowan Inc. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef __X_PACK_BSON_READER_H
+#define __X_PACK_BSON_READER_H
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <io.h>
+#endif
+
+#include "bson_decoder.h"
+
+namespace xpack {
+
+/*
+  reader of concatenated bson documents, such as the .bson file of mongodump.
+  a file is mapped into memory if possible, a fd(pipe, socket...) is read by chunk.
+
+  xpack::BsonReader reader("users.bson");
+  User u;
+  while (reader.next(u)) {
+      ...
+      u = User();
+  }
+*/
+class BsonReader:private noncopyable {
+public:
+    // documents in memory, not copied
+    BsonReader(const uint8_t *data, size_t len):_fd(-1), _close(false), _map(NULL), _data(data), _size(len), _pos(0), _dropped(0) {
+    }
+    // read from fd, fd is not closed
+    BsonReader(int fd, size_t chunk = 1024*1024):_fd(fd), _close(false), _map(NULL), _data(NULL), _size(0), _pos(0), _dropped(0) {
+        _buf.reserve(chunk > 5 ? chunk : 5);
+    }
+    BsonReader(const std::string &file_name):_close(true), _map(NULL), _data(NULL), _size(0), _pos(0), _dropped(0) {
+    #ifndef _MSC_VER
+        _fd = ::open(file_name.c_str(), O_RDONLY);
+    #else
+        _fd = ::_open(file_name.c_str(), O_RDONLY|O_BINARY);
+    #endif
+        if (_fd < 0) {
+            throw std::runtime_error("bson reader: open file fail: "+file_name);
+        }
+    #ifndef _MSC_VER
+        struct stat st;
+        if (0 == fstat(_fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, _fd, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+                _map = p;
+                _data = (const uint8_t*)p;
+                _size = (size_t)st.st_size;
+                return;
+            }
+        }
+    #endif
+        _buf.reserve(1024*1024);
+    }
+    ~BsonReader() {
+    #ifndef _MSC_VER
+        if (NULL != _map) {
+            munmap(_map, _size);
+        }
+        if (_close) {
+            ::close(_fd);
+        }
+    #else
+        if (_close) {
+            ::_close(_fd);
+        }
+    #endif
+    }
+
+    // next document [data, data+len), valid until the next call. return false if no more document
+    bool next(const uint8_t *&data, size_t &len) {
+        if (_fd < 0 || NULL != _map) {
+            return this->next_mem(data, len);
+        } else {
+            return this->next_fd(data, len);
+        }
+    }
+
+    // decode next document to val, return false if no more document
+    template <class T>
+    bool next(T &val) {
+        const uint8_t *data;
+        size_t len;
+        if (!this->next(data, len)) {
+            return false;
+        }
+        BsonDecoder de;
+        de.decode(data, len, val);
+        return true;
+    }
+
+private:
+    bool next_mem(const uint8_t *&data, size_t &len) {
+        if (_pos == _size) {
+            return false;
+        }
+        len = this->length(_data+_pos, _size-_pos);
+        data = _data+_pos;
+        _pos += len;
+    #ifndef _MSC_VER
+        if (NULL != _map && _pos-_dropped >= (64<<20)) { // keep the resident memory bounded for huge files
+            size_t page = (size_t)sysconf(_SC_PAGESIZE);
+            size_t end = (_pos-len)/page*page;
+            madvise((char*)_map+_dropped, end-_dropped, MADV_DONTNEED);
+            _dropped = end;
+        }
+    #endif
+        return true;
+    }
+    bool next_fd(const uint8_t *&data, size_t &len) {
+        if (!this->fill(4)) {
+            if (_pos == _buf.size()) {
+                return false;
+            }
+            throw std::runtime_error("bson reader: truncated document");
+        }
+        size_t need = this->get32(&_buf[_pos]);
+        if (need >= 5 && need <= 0x7fffffff && !this->fill(need)) {
+            throw std::runtime_error("bson reader: truncated document");
+        }
+        len = this->length(&_buf[_pos], _buf.size()-_pos);
+        data = &_buf[_pos];
+        _pos += len;
+        return true;
+    }
+    // make sure size bytes are available from _pos. consumed data is dropped only when reading
+    bool fill(size_t size) {
+        if (_buf.size()-_pos >= size) {
+            return true;
+        }
+        _buf.erase(_buf.begin(), _buf.begin()+_pos);
+        _pos = 0;
+        while (_buf.size() < size) {
+            size_t old = _buf.size();
+            size_t want = (_buf.capacity() > size) ? _buf.capacity() : size;
+            _buf.resize(want);
+        #ifndef _MSC_VER
+            ssize_t n = ::read(_fd, &_buf[old], want-old);
+        #else
+            int n = ::_read(_fd, &_buf[old], (unsigned)(want-old));
+        #endif
+            _buf.resize(old + ((n > 0) ? (size_t)n : 0));
+            if (n <= 0) {
+                if (n < 0 && EINTR == errno) {
+                    continue; // interrupted by a signal before any data is read
+                } else if (n < 0) {
+                    throw std::runtime_error("bson reader: read fail");
+                }
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // length of document at data, left bytes available
+    size_t length(const uint8_t *data, size_t left) const {
+        if (left < 5) {
+            throw std::runtime_error("bson reader: truncated document");
+        }
+        size_t len = this->get32(data);
+        if (len < 5 || len > 0x7fffffff) {
+            throw std::runtime_error("bson reader: invalid document length");
+        } else if (len > left) {
+            throw std::runtime_error("bson reader: truncated document");
+        } else if (data[len-1] != 0) {
+            throw std::runtime_error("bson reader: document not end with 0");
+        }
+        return len;
+    }
+    static size_t get32(const uint8_t *p) {
+        return (size_t)p[0] | ((size_t)p[1]<<8) | ((size_t)p[2]<<16) | ((size_t)p[3]<<24);
+    }
+
+    int _fd;
+    bool _close;                // _fd is opened by us
+    void *_map;                 // mapped file
+    const uint8_t *_data;       // memory or mapped file, used if _fd < 0 or _map != NULL
+    size_t _size;
+    size_t _pos;                // next document in _data or _buf
+    size_t _dropped;            // mapped pages before it are released
+    std::vector<uint8_t> _buf;  // read from fd
+};
+
+}
+
+#endif
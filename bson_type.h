@@ -29,6 +29,7 @@
 #include "xencoder.h"
 #include "xdecoder.h"
 #include "xpack.h"
+#include "util.h"
 
 /*
 // define in this file
@@ -36,6 +37,8 @@ bson_date_time_t
 bson_timestamp_t
 bson_binary_t
 bson_regex_t
+bson_utf8_view_t
+bson_binary_view_t
 
 // define in bson.h
 bson_oid_t
@@ -62,56 +65,15 @@ struct bson_date_time_t {
     bson_date_time_t(const int64_t&t=0):ts(t){}
     operator int64_t() const {return ts;}
 
-    // parse rfc3339 time format(milliseconds). C++ doesn't even have a full-featured standard time library T_T
-    // "2000-01-01T01:01:01[.001]Z[07:00]" string should ends with \0
+    // parse rfc3339 time format(milliseconds), "2000-01-01T01:01:01[.001](Z|+07:00)" string should ends with \0
     bool parse_rfc3339(const char buf[]) {
-        struct tm tm;
-        memset((void*)&tm, 0, sizeof(tm));
-
-        const char *end = strptime(buf, "%Y-%m-%dT%H:%M:%S", &tm);
-        if (end == NULL) {
-            return false;
-        }
-
-        int msec = 0;
-        int offset = 0;
-        try {
-            size_t pos;
-            if (*end == '.') {
-                msec = std::stoi(end+1, &pos);
-                if (pos==0 || pos > 3) {
-                    return false;
-                }
-                end += pos+1;
-            }
-            if (*end != 'Z') {
-                pos = 0;
-                int hour = std::stoi(end, &pos);
-                if (pos == 0 || pos > 3) {
-                    return false;
-                }
-                end += pos;
-                if (*end != ':') {
-                    return false;
-                }
-                int min = std::stoi(end+1, &pos);
-                if (hour > 0) {
-                    offset = hour*3600 + min*60;
-                } else {
-                    offset = -(-hour*3600 + min*60);
-                }
-            } else {
-                ++end;
-                if (*end != '\0') {
-                    return false;
-                }
-            }
-        } catch(...) {
+        int64_t sec;
+        int usec;
+        bool zone;
+        if (!xpack::Util::parse_datetime(buf, strlen(buf), sec, usec, zone) || !zone) {
             return false;
         }
-
-        time_t tmp = mktime(&tm);
-        ts = tmp*1000 + msec - offset - timezone*1000;
+        ts = sec*1000 + usec/1000;
         return true;
     }
 };
@@ -195,6 +157,27 @@ struct bson_binary_t {
     }
 };
 
+/*
+  views reference the data of the source bson document instead of copying it.
+  they are valid only while that data is alive and unchanged: the string passed
+  to bson::decode, or the current document in a bson::for_each callback.
+  only BsonDecoder/BsonEncoder support them.
+*/
+struct bson_utf8_view_t {
+    const char *data;   // not null terminated
+    size_t length;
+    bson_utf8_view_t(const char *d=NULL, size_t l=0):data(d),length(l){}
+    std::string str() const {
+        return std::string(data, length);
+    }
+};
+struct bson_binary_view_t {
+    const uint8_t *data;
+    size_t length;
+    bson_subtype_t subType;
+    bson_binary_view_t(const uint8_t *d=NULL, size_t l=0, bson_subtype_t st=BSON_SUBTYPE_BINARY):data(d),length(l),subType(st){}
+};
+
 namespace xpack {
 
 // bson type to json
@@ -242,7 +225,7 @@ bool xpack_xtype_decode(Decoder &de, bson_date_time_t &val, const Extend *ext) {
         return ret;
     } catch (...){}
 
-    char buf[25];
+    char buf[40]; // room for fraction and offset
     try {
         ret = de.decode(dkey, buf, NULL);
         if (ret) {
@@ -266,21 +249,7 @@ bool xpack_xtype_encode(Encoder &en, const char*key, const bson_date_time_t &val
     en.ObjectBegin(key, ext);
     if (val.ts >= 0) {
         char buf[32];
-        int msecs = int(val.ts % 1000);
-        time_t secs = (time_t)(val.ts/1000);
-
-        #ifndef _MSC_VER
-        struct tm posix_date;
-        size_t sz = strftime(buf, sizeof buf, "%FT%T", gmtime_r(&secs, &posix_date));
-        #else
-        size_t sz = strftime(buf, sizeof buf, "%FT%T", gmtime(&secs));
-        #endif
-
-        if (msecs > 0) {
-            sprintf(&buf[sz], ".%03dZ", msecs);
-        } else {
-            strcpy(&buf[sz], "Z");
-        }
+        Util::format_datetime(val.ts, buf);
         en.encode("$date", buf, NULL);
     } else { // key:{"$date":{"$numberLong":ts}} ts use string not int 
         en.ObjectBegin("$date", NULL);
@@ -21,5 +21,9 @@
 // support qt
 //#define XPACK_SUPPORT_QT
 
+// decode/encode statistics, see instrument.h
+//#define XPACK_INSTRUMENT
+//#define XPACK_INSTRUMENT_FIELD
+
 
 #endif
@@ -0,0 +1,145 @@
+/*
+* Copyright (C) 2021 Duowan Inc. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef __X_PACK_FIELD_H
+#define __X_PACK_FIELD_H
+
+#include <cstddef>
+#include <vector>
+
+#include "traits.h"
+#include "extend.h"
+
+namespace xpack {
+
+// how the member is declared in XPACK/XPACK_OUT
+#define X_PACK_FIELD_KIND_O 0 // O/M/X
+#define X_PACK_FIELD_KIND_E 1 // E, enum
+#define X_PACK_FIELD_KIND_A 2 // A/AF, alias
+#define X_PACK_FIELD_KIND_C 3 // C, custom codec
+#define X_PACK_FIELD_KIND_B 4 // B, bitfield
+#define X_PACK_FIELD_KIND_I 5 // I, inherit. name is the parent type, the visitor is not called for it
+
+/*
+  field table generated by XPACK/XPACK_OUT, not bound to any encoder/decoder.
+  the table is a function local static array of constant expressions, so it is
+  initialized at compile time(no guard, no allocation) and live for the whole program.
+*/
+struct Field {
+    const char *name;   // member name
+    const char *alias;  // alias define of A/AF, NULL for others
+    int flag;           // X_PACK_FLAG_xxx
+    int kind;           // X_PACK_FIELD_KIND_xxx
+};
+
+// XPACK_OUT specialize it
+template <class T>
+const Field* __x_pack_fields_out(size_t &num);
+
+// field table of T, num is set to the number of entries
+template <class T>
+inline typename x_enable_if<T::__x_pack_value && !is_xpack_out<T>::value, const Field*>::type fields(size_t &num) {
+    return T::__x_pack_fields(num);
+}
+template <class T>
+inline typename x_enable_if<is_xpack_out<T>::value, const Field*>::type fields(size_t &num) {
+    return __x_pack_fields_out<T>(num);
+}
+
+/*
+  what the generated __x_pack_decode/__x_pack_encode need for each entry of the field table:
+  the key(alias resolved for the coder) and the Extend passed to it. it is built once per
+  (struct, coder) from the field table and the generated code replays it by position,
+  so nothing is constructed or looked up per call.
+*/
+class FieldPlan:private noncopyable {
+public:
+    struct Step {
+        const char *name;
+        Extend ext;
+        Step(const char *_name, int flag, const Alias *alias):name(_name), ext(flag, alias) {}
+    };
+
+    // coder is NULL if the coder has no Name(), then alias uses the field name
+    FieldPlan(const Field* (*table)(size_t&), const char *coder) {
+        size_t num;
+        const Field *f = table(num);
+        _steps.reserve(num);
+        for (size_t i=0; i<num; ++i) {
+            if (X_PACK_FIELD_KIND_A == f[i].kind) {
+                Alias *alias = new Alias(f[i].name, f[i].alias);
+                _aliases.push_back(alias);
+                _steps.push_back(Step((NULL != coder) ? alias->Name(coder) : f[i].name, f[i].flag, alias));
+            } else {
+                _steps.push_back(Step(f[i].name, f[i].flag, NULL));
+                if (X_PACK_FIELD_KIND_I == f[i].kind) {
+                    _steps.back().ext.ctrl_flag |= X_PACK_CTRL_FLAG_INHERIT;
+                }
+            }
+        }
+    }
+    ~FieldPlan() {
+        for (size_t i=0; i<_aliases.size(); ++i) {
+            delete _aliases[i];
+        }
+    }
+    const Step& operator[](size_t i) const {
+        return _steps[i];
+    }
+private:
+    std::vector<Step> _steps;
+    std::vector<Alias*> _aliases;
+};
+
+// visit a const object, members are passed to the visitor as const
+template <class V>
+struct ConstVisitor {
+    V &v;
+    ConstVisitor(V &_v):v(_v){}
+    template <class T>
+    void operator()(const Field &f, T &m) {
+        v(f, static_cast<const T&>(m));
+    }
+};
+
+/*
+  call visitor(const xpack::Field&, member&) for every member in declaration order.
+  inherited members are visited before the members after I(...). bitfield is passed
+  as a temporary of its underlying type and written back if the visitor changes it.
+  struct Hash {
+      size_t h;
+      template <class T> void operator()(const xpack::Field &f, const T &m) {...}
+  };
+*/
+template <class T, class V>
+inline typename x_enable_if<T::__x_pack_value && !is_xpack_out<T>::value, void>::type visit(T &obj, V &visitor) {
+    size_t num;
+    obj.__x_pack_visit(fields<T>(num), visitor, obj);
+}
+template <class T, class V>
+inline typename x_enable_if<is_xpack_out<T>::value, void>::type visit(T &obj, V &visitor) {
+    size_t num;
+    __x_pack_visit_out(fields<T>(num), visitor, obj);
+}
+template <class T, class V>
+inline void visit(const T &obj, V &visitor) {
+    ConstVisitor<V> cv(visitor);
+    visit(const_cast<T&>(obj), cv); // members are only read
+}
+
+}
+
+#endif
@@ -26,6 +26,11 @@
 #include "xpack/json.h"
 #include "xpack/bson.h"
 #include "string.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <thread>
 
 using namespace std;
 
@@ -432,6 +437,10 @@ TEST(base, bson_types) {
     BsonTypes bt3;
     xpack::bson::decode(en.encode(bt), bt3);
     checkBsonTypes(bt, bt3, true);
+
+    // fraction and offset need more than 25 bytes
+    xpack::json::decode("{\"dt\":{\"$date\":\"2021-12-02T00:00:00.018+08:00\"}}", bt3);
+    EXPECT_EQ(bt3.dt.ts, 1638374400018LL);
 }
 
 TEST(bson, builders) {
@@ -445,6 +454,129 @@ TEST(bson, builders) {
     cout<<"json3:"<<bd.EncodeAsJson("Lang", "C++", "")<<endl;
 }
 
+TEST(bson, builder_cache) {
+    for (int i=0; i<3; ++i) {
+        Base b;
+        xpack::bson::decode(xpack::BsonBuilder::En("{'a':?, 'b':?}", i, "s"+to_string(i)), b);
+        EXPECT_EQ(b.a, i);
+        EXPECT_EQ(b.b, "s"+to_string(i));
+    }
+    EXPECT_EQ(xpack::BsonBuilder::En("{'a':", 1), "");
+}
+
+struct BaseCollector {
+    vector<Base> *docs;
+    void operator()(Base &b) {
+        docs->push_back(b);
+    }
+};
+TEST(reader, for_each) {
+    string data = xpack::bson::encode(Base(1, "x")) + xpack::bson::encode(Base(2, "")) + xpack::bson::encode(Base(3, "z"));
+    const char *file = "/tmp/xpack_reader_test.bson";
+    FILE *fp = fopen(file, "wb");
+    fwrite(data.data(), 1, data.size(), fp);
+    fclose(fp);
+
+    vector<Base> docs;
+    BaseCollector c;
+    c.docs = &docs;
+    EXPECT_EQ(xpack::bson::for_each<Base>(string(file), c), 3U);
+    int fd = open(file, O_RDONLY);
+    EXPECT_EQ(xpack::bson::for_each<Base>(fd, c), 3U);
+    close(fd);
+    EXPECT_EQ(xpack::bson::for_each<Base>((const uint8_t*)data.data(), data.size(), c), 3U);
+    EXPECT_EQ(docs.size(), 9U);
+    EXPECT_EQ(docs[4].a, 2);
+    EXPECT_EQ(docs[4].b, "");
+    EXPECT_EQ(docs[8].b, "z");
+    unlink(file);
+
+    bool except = false;
+    try {
+        xpack::bson::for_each<Base>((const uint8_t*)data.data(), data.size()-1, c);
+    } catch (const std::exception&e) {
+        except = NULL != strstr(e.what(), "truncated");
+    }
+    EXPECT_TRUE(except);
+}
+
+static void on_signal(int) {
+}
+TEST(reader, eintr) {
+    // read is interrupted by a signal before the data comes, it is retried
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal; // no SA_RESTART
+    sigaction(SIGUSR1, &sa, NULL);
+
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+    string data = xpack::bson::encode(Base(1, "x"));
+    pthread_t reader = pthread_self();
+    std::thread writer([&]() {
+        usleep(100000);
+        pthread_kill(reader, SIGUSR1);
+        usleep(100000);
+        EXPECT_EQ(write(fds[1], data.data(), data.size()), (ssize_t)data.size());
+        close(fds[1]);
+    });
+
+    vector<Base> docs;
+    BaseCollector c;
+    c.docs = &docs;
+    bool except = false;
+    try {
+        xpack::bson::for_each<Base>(fds[0], c);
+    } catch (const std::exception&e) {
+        except = true;
+    }
+    writer.join();
+    close(fds[0]);
+    signal(SIGUSR1, SIG_DFL);
+    EXPECT_TRUE(!except);
+    EXPECT_EQ(docs.size(), 1U);
+}
+
+struct Chunk {
+    bson_utf8_view_t   name;
+    bson_binary_view_t data;
+    int                n;
+    XPACK(O(name, data, n));
+};
+struct ChunkCopy {
+    string        name;
+    bson_binary_t data;
+    int           n;
+    XPACK(O(name, data, n));
+};
+TEST(view, chunk) {
+    string payload(1000, 'p');
+    Chunk c;
+    c.name = bson_utf8_view_t("file", 4);
+    c.data = bson_binary_view_t((const uint8_t*)payload.data(), payload.size(), BSON_SUBTYPE_USER);
+    c.n = 3;
+    string doc = xpack::bson::encode(c);
+
+    Chunk c1;
+    xpack::bson::decode(doc, c1);
+    EXPECT_EQ(c1.name.str(), "file");
+    EXPECT_EQ(c1.data.length, payload.size());
+    EXPECT_EQ(c1.data.subType, BSON_SUBTYPE_USER);
+    EXPECT_EQ(c1.n, 3);
+    // point to doc
+    EXPECT_TRUE(c1.data.data > (const uint8_t*)doc.data() && c1.data.data+c1.data.length < (const uint8_t*)doc.data()+doc.size());
+    EXPECT_EQ(0, memcmp(c1.data.data, payload.data(), payload.size()));
+
+    ChunkCopy cc; // same as std::string and bson_binary_t
+    xpack::bson::decode(doc, cc);
+    EXPECT_EQ(cc.data.data, payload);
+    EXPECT_EQ(xpack::bson::encode(cc), doc);
+    Chunk c2;
+    xpack::bson::decode(xpack::BsonBuilder::En("{'n':2, 'name':?}", 5), c2);
+    EXPECT_EQ(c2.name.length, 0U);
+    EXPECT_EQ(c2.n, 2);
+}
+
 // +++++++++++++++++++ QT ++++++++++++++++++++
 #ifdef XPACK_SUPPORT_QT
 struct ContainerQT {
@@ -536,6 +668,49 @@ TEST(flags, M) {
     EXPECT_TRUE(except);
 }
 // ++++++++++++++++++bug history+++++++++++++++++++++++
+// keys are searched from the last found one
+struct Reordered {
+    string b;
+    int    x;
+    int    a;
+    XPACK(O(b, x, a));
+};
+TEST(lookup, order) {
+    vector<Reordered> r;
+    r.resize(1);
+    r[0].x = 7;
+    xpack::bson::decode(xpack::BsonBuilder::En("{'a':1, 'b':'b1', 'c':[1,2]}"), r[0]);
+    EXPECT_EQ(r[0].a, 1);
+    EXPECT_EQ(r[0].b, "b1");
+    EXPECT_EQ(r[0].x, 7);
+
+    map<string, vector<Base> > m;
+    m["k1"].push_back(Base(1, "x"));
+    m["k1"].push_back(Base(2, "y"));
+    m["k2"];
+    map<string, vector<Reordered> > m1;
+    xpack::bson::decode(xpack::bson::encode(m), m1);
+    EXPECT_EQ(m1.size(), 2U);
+    EXPECT_EQ(m1["k1"].size(), 2U);
+    EXPECT_EQ(m1["k1"][1].a, 2);
+    EXPECT_EQ(m1["k1"][1].b, "y");
+    EXPECT_EQ(m1["k2"].size(), 0U);
+}
+
+TEST(writer, layout) {
+    Base b(1, "x");
+    string s = xpack::bson::encode(b);
+    EXPECT_EQ(s, string("\x15\0\0\0\x10" "a\0\x01\0\0\0\x02" "b\0\x02\0\0\0x\0\0", 0x15));
+
+    ContainerBase c;
+    c.vv.resize(2);
+    c.vv[1].resize(1200);
+    c.vv[1][1100] = 5;
+    ContainerBase c1;
+    xpack::bson::decode(xpack::BsonEncoder().SetReserve(16).encode(c), c1);
+    EXPECT_TRUE(c1.vv == c.vv);
+}
+
 TEST(bughis, notexists) {
     Base b(9, "");
 
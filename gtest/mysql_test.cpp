@@ -0,0 +1,148 @@
+/*
+* Copyright (C) 2021 Duowan Inc. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+// need libmysqlclient and a server. MYSQL_HOST/MYSQL_USER/MYSQL_PWD/MYSQL_DB, default 127.0.0.1/root/(none)/test
+// skipped if the server can not be connected
+
+#include <iostream>
+#include <stdlib.h>
+#ifdef XGTEST
+#include<gtest/gtest.h>
+#else
+#include "gtest_stub.h"
+#endif
+
+#include "xpack/mysql.h"
+#include "string.h"
+
+using namespace std;
+
+struct User {
+    int64_t id;
+    string  name;
+    double  score;
+    XPACK(O(id, name, score));
+};
+
+struct UserCollector {
+    vector<User> *users;
+    void operator()(User &u) {
+        users->push_back(u);
+    }
+};
+
+static MYSQL *conn = NULL;
+
+static const char *env(const char *name, const char *def) {
+    const char *v = getenv(name);
+    return (NULL != v) ? v : def;
+}
+
+TEST(result, vector) {
+    EXPECT_EQ(mysql_query(conn, "select * from user order by id"), 0);
+    MYSQL_RES *res = mysql_store_result(conn);
+    vector<User> users;
+    xpack::mysql::decode(res, users);
+    mysql_free_result(res);
+
+    EXPECT_EQ(users.size(), 3U);
+    EXPECT_EQ(users[0].id, 1);
+    EXPECT_EQ(users[0].name, "lilei");
+    EXPECT_DOUBLE_EQ(users[0].score, 90.5);
+    EXPECT_EQ(users[2].id, 8589934592LL);
+    EXPECT_EQ(users[1].name, ""); // null
+}
+
+TEST(result, for_each) {
+    EXPECT_EQ(mysql_query(conn, "select id, name from user order by id"), 0);
+    MYSQL_RES *res = mysql_use_result(conn);
+    vector<User> users;
+    UserCollector c;
+    c.users = &users;
+    EXPECT_EQ(xpack::mysql::for_each<User>(res, c), 3U);
+    mysql_free_result(res);
+
+    EXPECT_EQ(users.size(), 3U);
+    EXPECT_EQ(users[0].name, "lilei");
+    EXPECT_EQ(users[1].name, ""); // reset between rows
+}
+
+TEST(result, error) {
+    // rows are sent before the subquery fails on the second row
+    EXPECT_EQ(mysql_query(conn, "select u.id, (select name from user where id >= u.id) as name from user u order by u.id desc"), 0);
+    MYSQL_RES *res = mysql_use_result(conn);
+    vector<User> users;
+    UserCollector c;
+    c.users = &users;
+    bool except = false;
+    try {
+        xpack::mysql::for_each<User>(res, c);
+    } catch (const std::exception&e) {
+        except = NULL != strstr(e.what(), "more than 1 row");
+    }
+    mysql_free_result(res);
+    EXPECT_TRUE(except);
+    EXPECT_EQ(users.size(), 1U);
+}
+
+TEST(stmt, for_each) {
+    const char *sql = "select id, name, score from user where id < ? order by id";
+    MYSQL_STMT *stmt = mysql_stmt_init(conn);
+    EXPECT_EQ(mysql_stmt_prepare(stmt, sql, strlen(sql)), 0);
+
+    int limit = 10;
+    MYSQL_BIND param;
+    memset(&param, 0, sizeof(param));
+    param.buffer_type = MYSQL_TYPE_LONG;
+    param.buffer = &limit;
+    mysql_stmt_bind_param(stmt, &param);
+    EXPECT_EQ(mysql_stmt_execute(stmt), 0);
+
+    vector<User> users;
+    UserCollector c;
+    c.users = &users;
+    EXPECT_EQ(xpack::mysql::for_each<User>(stmt, c), 2U);
+    mysql_stmt_close(stmt);
+
+    EXPECT_EQ(users.size(), 2U);
+    EXPECT_EQ(users[0].id, 1);
+    EXPECT_DOUBLE_EQ(users[0].score, 90.5);
+    EXPECT_EQ(users[1].id, 2);
+    EXPECT_EQ(users[1].name, "");
+}
+
+int main(int argc, char *argv[]) {
+    conn = mysql_init(NULL);
+    if (NULL == mysql_real_connect(conn, env("MYSQL_HOST", "127.0.0.1"), env("MYSQL_USER", "root"), getenv("MYSQL_PWD"), env("MYSQL_DB", "test"), 0, NULL, 0)) {
+        cout<<"skip mysql test: "<<mysql_error(conn)<<endl;
+        mysql_close(conn);
+        return 0;
+    }
+    mysql_query(conn, "create temporary table user(id bigint, name varchar(32), score double)");
+    mysql_query(conn, "insert into user values(1, 'lilei', 90.5), (2, null, 60), (8589934592, 'hanmeimei', null)");
+
+    int ret = 0;
+#ifdef XGTEST
+    testing::InitGoogleTest(&argc, argv);
+    ret = RUN_ALL_TESTS();
+#else
+    (void)argc;
+    (void)argv;
+    TC_CONTAINER::RUN();
+#endif
+    mysql_close(conn);
+    return ret;
+}
@@ -0,0 +1,148 @@
+/*
+* Copyright (C) 2021 Duowan Inc. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+// need libsqlite3
+
+#include <iostream>
+#ifdef XGTEST
+#include<gtest/gtest.h>
+#else
+#include "gtest_stub.h"
+#endif
+
+#include "xpack/sqlite_stmt.h"
+#include "string.h"
+
+using namespace std;
+
+struct Extra {
+    int    level;
+    string tag;
+    XPACK(O(level, tag));
+};
+
+struct User {
+    int64_t id;
+    string  name;
+    double  score;
+    bool    vip;
+    string  avatar;
+    Extra   extra;
+    int     missing;
+    XPACK(O(id, name, score, vip, avatar, extra, missing));
+};
+
+class Database {
+public:
+    Database():db(NULL) {
+        sqlite3_open(":memory:", &db);
+        exec("create table user(id integer, name text, score real, vip int, avatar blob, extra text)");
+        exec("insert into user values(8589934592, 'lilei', 90.5, 1, x'00ff01', '{\"level\":3,\"tag\":\"a\"}')");
+        exec("insert into user values(2, 'hanmeimei', 60, 0, null, null)");
+        exec("insert into user values(3, null, null, null, x'', '{}')");
+    }
+    ~Database() {
+        sqlite3_close(db);
+    }
+    void exec(const char *sql) {
+        sqlite3_exec(db, sql, NULL, NULL, NULL);
+    }
+    sqlite3_stmt *prepare(const char *sql) {
+        sqlite3_stmt *stmt = NULL;
+        sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+        return stmt;
+    }
+    sqlite3 *db;
+};
+
+TEST(stmt, vector) {
+    Database db;
+    sqlite3_stmt *stmt = db.prepare("select * from user order by id desc");
+    vector<User> users;
+    xpack::sqlite_stmt::decode(stmt, users);
+    sqlite3_finalize(stmt);
+
+    EXPECT_EQ(users.size(), 3U);
+    EXPECT_EQ(users[0].id, 8589934592LL);
+    EXPECT_EQ(users[0].name, "lilei");
+    EXPECT_DOUBLE_EQ(users[0].score, 90.5);
+    EXPECT_TRUE(users[0].vip);
+    EXPECT_EQ(users[0].avatar, string("\x00\xff\x01", 3));
+    EXPECT_EQ(users[0].extra.level, 3);
+    EXPECT_EQ(users[0].extra.tag, "a");
+    EXPECT_EQ(users[2].id, 2);
+    EXPECT_DOUBLE_EQ(users[2].score, 60); // integer stored in real column
+    EXPECT_TRUE(!users[2].vip);
+    EXPECT_EQ(users[2].avatar, "");
+    EXPECT_EQ(users[1].name, ""); // null
+    EXPECT_EQ(users[1].extra.level, 0);
+}
+
+struct UserCollector {
+    vector<User> *users;
+    void operator()(User &u) {
+        users->push_back(u);
+    }
+};
+TEST(stmt, for_each) {
+    Database db;
+    sqlite3_stmt *stmt = db.prepare("select name as missing, id, name from user where id < ? order by id");
+    sqlite3_bind_int(stmt, 1, 10);
+    vector<User> users;
+    UserCollector c;
+    c.users = &users;
+    EXPECT_EQ(xpack::sqlite_stmt::for_each<User>(stmt, c), 2U);
+    EXPECT_EQ(users.size(), 2U);
+    EXPECT_EQ(users[0].id, 2);
+    EXPECT_EQ(users[0].name, "hanmeimei");
+    EXPECT_EQ(users[0].missing, 0); // text to int as sqlite does
+    EXPECT_EQ(users[1].id, 3);
+    EXPECT_EQ(users[1].name, ""); // reset between rows
+
+    sqlite3_reset(stmt);
+    sqlite3_bind_int(stmt, 1, 3);
+    User u;
+    xpack::sqlite_stmt::decode(stmt, u);
+    EXPECT_EQ(u.id, 2);
+    sqlite3_finalize(stmt);
+}
+
+TEST(stmt, error) {
+    Database db;
+    db.exec("create table uniq(id int unique)");
+    sqlite3_stmt *stmt = db.prepare("insert into uniq values(1),(1) returning id");
+    bool except = false;
+    try {
+        vector<User> users;
+        xpack::sqlite_stmt::decode(stmt, users);
+    } catch (const std::exception&e) {
+        except = NULL != strstr(e.what(), "UNIQUE");
+    }
+    sqlite3_finalize(stmt);
+    EXPECT_TRUE(except);
+}
+
+int main(int argc, char *argv[]) {
+#ifdef XGTEST
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+#else
+    (void)argc;
+    (void)argv;
+    TC_CONTAINER::RUN();
+    return 0;
+#endif
+}
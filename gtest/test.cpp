@@ -793,6 +793,25 @@ TEST(flags, vectorlabel) {
     EXPECT_EQ(f1.c[1], 6);
 }
 
+struct FlagMultiSbs {
+    vector<int> x;
+    vector<string> y;
+    vector<int> z;
+    int w;
+    XPACK(A(x, "xml:x,sbs", y, "xml:y,sbs", z, "xml:z,sbs"), O(w));
+};
+TEST(flags, multisbs) {
+    FlagMultiSbs f;
+    xpack::xml::decode("<root><x>1</x><y>a</y><x>2</x><w>7</w><y>b</y><x>3</x><y>c</y></root>", f);
+    EXPECT_EQ(f.x.size(), 3U);
+    EXPECT_EQ(f.x[0], 1);
+    EXPECT_EQ(f.x[2], 3);
+    EXPECT_EQ(f.y.size(), 3U);
+    EXPECT_EQ(f.y[1], "b");
+    EXPECT_EQ(f.z.size(), 0U);
+    EXPECT_EQ(f.w, 7);
+}
+
 TEST(jsondata, memory) {
     xpack::JsonData *jd = new xpack::JsonData;
 
@@ -810,6 +829,628 @@ TEST(jsondata, memory) {
     EXPECT_EQ(s[1].Get<int64_t>(), 1);    
 }
 
+// ++++++++++++++++++ merge patch ++++++++++++++++++++++
+struct PatchChild {
+    int a;
+    string b;
+    vector<int> v;
+    PatchChild():a(0){}
+    XPACK(O(a, b, v));
+};
+struct PatchTop {
+    int i;
+    string s;
+    PatchChild c;
+    map<string, int> m;
+    vector<Base> vb;
+    PatchTop():i(0){}
+    XPACK(O(i, s, c, m, vb));
+};
+TEST(patch, json) {
+    PatchTop p;
+    p.i = 1;
+    p.s = "hello";
+    p.c.a = 2;
+    p.c.b = "child";
+    p.c.v.push_back(3);
+    p.m["x"] = 4;
+    p.m["y"] = 5;
+    p.vb.push_back(Base(6, "six"));
+    const int *vdata = &p.c.v[0];
+
+    xpack::json::apply_patch("{\"s\":null, \"c\":{\"a\":20}, \"m\":{\"x\":null, \"z\":6}, \"vb\":[{\"a\":7}]}", p);
+    EXPECT_EQ(p.i, 1);
+    EXPECT_EQ(p.s, "");
+    EXPECT_EQ(p.c.a, 20);
+    EXPECT_EQ(p.c.b, "child");
+    EXPECT_TRUE(vdata == &p.c.v[0]); // untouched members keep their storage
+    EXPECT_EQ(p.m.size(), 2U);
+    EXPECT_TRUE(p.m.find("x") == p.m.end());
+    EXPECT_EQ(p.m["y"], 5);
+    EXPECT_EQ(p.m["z"], 6);
+    EXPECT_EQ(p.vb.size(), 1U);
+    EXPECT_EQ(p.vb[0].a, 7);
+    EXPECT_EQ(p.vb[0].b, ""); // array is replaced, not merged
+
+    xpack::json::apply_patch("{\"c\":null}", p);
+    EXPECT_EQ(p.c.a, 0);
+    EXPECT_EQ(p.c.b, "");
+    EXPECT_EQ(p.c.v.size(), 0U);
+    EXPECT_EQ(p.i, 1);
+}
+
+struct PatchBits {
+    short a:8;
+    short b:8;
+    int c;
+    XPACK(B(F(0), a, b), O(c));
+};
+TEST(patch, bitfield) {
+    PatchBits p;
+    p.a = 3;
+    p.b = 4;
+    p.c = 5;
+    xpack::json::apply_patch("{\"c\":7}", p);
+    EXPECT_EQ(p.a, 3);
+    EXPECT_EQ(p.b, 4);
+    EXPECT_EQ(p.c, 7);
+    xpack::json::apply_patch("{\"b\":-2}", p);
+    EXPECT_EQ(p.a, 3);
+    EXPECT_EQ(p.b, -2);
+}
+
+// ++++++++++++++++++ visit ++++++++++++++++++++++++++++
+struct VisitNames {
+    string names;
+    int sum;
+    VisitNames():sum(0){}
+    void operator()(const xpack::Field &f, const int &v) { names += f.name; sum += v; }
+    void operator()(const xpack::Field &f, const short &v) { names += f.name; sum += v; }
+    template <class T>
+    void operator()(const xpack::Field &f, const T &v) { (void)v; names += f.name; }
+};
+struct VisitInc {
+    template <class T>
+    void operator()(const xpack::Field &f, T &v) { (void)f; ++v; }
+};
+TEST(visit, fields) {
+    size_t num = 0;
+    const xpack::Field *f = xpack::fields<BuiltInTypes>(num);
+    EXPECT_EQ(num, 15U);
+    EXPECT_EQ(string(f[0].name), "sch");
+    EXPECT_EQ(string(f[0].alias), "xml:s:ch");
+    EXPECT_EQ(f[0].flag, X_PACK_FLAG_ATTR);
+    EXPECT_EQ(f[0].kind, X_PACK_FIELD_KIND_A);
+    EXPECT_EQ(string(f[1].name), "ch");
+    EXPECT_TRUE(f[1].alias == NULL);
+    EXPECT_EQ(f[1].flag, X_PACK_FLAG_ATTR);
+    EXPECT_EQ(string(f[14].name), "b");
+    EXPECT_EQ(f[14].flag, 0);
+
+    f = xpack::fields<InheritChild>(num);
+    EXPECT_EQ(num, 3U);
+    EXPECT_EQ(string(f[0].name), "InheritBase");
+    EXPECT_EQ(f[0].kind, X_PACK_FIELD_KIND_I);
+}
+TEST(visit, members) {
+    InheritChild c;
+    c.b1 = 1;
+    c.b2 = "b2";
+    c.c1 = 10;
+    c.c2 = "c2";
+    VisitNames vn;
+    xpack::visit(c, vn);
+    EXPECT_EQ(vn.names, "b1b2c1c2");
+    EXPECT_EQ(vn.sum, 11);
+
+    BitField bf;
+    bf.a = 1;
+    bf.b = 2;
+    VisitInc vi;
+    xpack::visit(bf, vi);
+    EXPECT_EQ(bf.a, 2);
+    EXPECT_EQ(bf.b, 3);
+
+    const BitField &cbf = bf;
+    VisitNames vb;
+    xpack::visit(cbf, vb);
+    EXPECT_EQ(vb.names, "ab");
+    EXPECT_EQ(vb.sum, 5);
+}
+
+// ++++++++++++++++++ decode plan ++++++++++++++++++++++
+struct PlanOrder {
+    int a;
+    int b;
+    int c;
+    int x;
+    XPACK(O(a, b, c), A(x, "json:jx xml:xx"));
+};
+TEST(plan, order) {
+    // keys in order, out of order, missing and repeated decode of the same type
+    const char *js[] = {"{\"a\":1,\"b\":2,\"c\":3,\"jx\":4}", "{\"jx\":4,\"c\":3,\"a\":1,\"b\":2}", "{\"b\":2,\"z\":0,\"jx\":4,\"a\":1,\"c\":3}"};
+    for (size_t i=0; i<sizeof(js)/sizeof(js[0]); ++i) {
+        PlanOrder p;
+        xpack::json::decode(js[i], p);
+        EXPECT_EQ(p.a, 1);
+        EXPECT_EQ(p.b, 2);
+        EXPECT_EQ(p.c, 3);
+        EXPECT_EQ(p.x, 4);
+    }
+
+    // alias resolved per format
+    PlanOrder p;
+    xpack::xml::decode("<root><a>1</a><b>2</b><c>3</c><xx>5</xx></root>", p);
+    EXPECT_EQ(p.x, 5);
+    EXPECT_EQ(xpack::json::encode(p), "{\"a\":1,\"b\":2,\"c\":3,\"jx\":5}");
+
+    // what the generated code replays
+    xpack::FieldPlan plan(&PlanOrder::__x_pack_fields, "xml");
+    EXPECT_EQ(string(plan[0].name), "a");
+    EXPECT_TRUE(plan[0].ext.alias == NULL);
+    EXPECT_EQ(string(plan[3].name), "xx");
+    EXPECT_TRUE(plan[3].ext.alias != NULL);
+}
+
+struct PlanDup {
+    int a;
+    int b;
+    XPACK(O(b, a));
+};
+TEST(plan, duplicated) {
+    // the first one wins as FindMember, with or without the cursor
+    PlanDup d1;
+    xpack::json::decode("{\"a\":1,\"b\":2,\"a\":3}", d1);
+    EXPECT_EQ(d1.a, 1);
+    EXPECT_EQ(d1.b, 2);
+
+    std::string s = "{\"a\":1,\"b\":2,\"a\":3";
+    for (int i=0; i<X_PACK_JSON_CURSOR_THRESHOLD; ++i) {
+        s += ",\"x"+xpack::Util::itoa(i)+"\":0";
+    }
+    s += "}";
+    PlanDup d2;
+    xpack::json::decode(s, d2);
+    EXPECT_EQ(d2.a, 1);
+    EXPECT_EQ(d2.b, 2);
+}
+
+// ++++++++++++++++++ decode_each ++++++++++++++++++++++
+struct EachRecord {
+    vector<int> v;
+    int n;
+    EachRecord():n(7) {}
+};
+struct EachReader {
+    int left;
+    vector<size_t> caps; // capacity of v before each record
+    bool next(EachRecord &r) {
+        if (0 == left--) {
+            return false;
+        }
+        EXPECT_EQ(r.n, 7);
+        EXPECT_TRUE(r.v.empty());
+        caps.push_back(r.v.capacity());
+        r.v.resize(100);
+        r.n = left;
+        return true;
+    }
+};
+struct EachCounter {
+    int *sum;
+    void operator()(EachRecord &r) {
+        *sum += r.n;
+    }
+};
+TEST(decode_each, reuse) {
+    EachReader rd;
+    rd.left = 3;
+    int sum = 0;
+    EachCounter c;
+    c.sum = &sum;
+    EXPECT_EQ(xpack::decode_each<EachRecord>(rd, c), 3U);
+    EXPECT_EQ(sum, 3);
+    EXPECT_EQ(rd.caps.size(), 3U);
+    EXPECT_TRUE(rd.caps[1] >= 100); // reset to T() but the buffer is kept
+    EXPECT_TRUE(rd.caps[2] >= 100);
+}
+
+// ++++++++++++++++++ instrument +++++++++++++++++++++++
+#ifdef XPACK_INSTRUMENT
+TEST(instrument, stat) {
+    xpack::Instrument::Reset();
+    InheritChild c;
+    c.b1 = 1;
+    c.c1 = 2;
+    string s = xpack::json::encode(c);
+    InheritChild d;
+    xpack::json::decode(s, d);
+    xpack::json::decode(s, d);
+
+    xpack::InstrumentSnapshot st = xpack::Instrument::Snapshot();
+    EXPECT_EQ(st["InheritChild"].encode.calls, 1U);
+    EXPECT_EQ(st["InheritChild"].encode.bytes, s.size());
+    EXPECT_EQ(st["InheritChild"].decode.calls, 2U);
+    EXPECT_EQ(st["InheritChild"].decode.bytes, 2*s.size());
+    EXPECT_EQ(st["InheritBase"].decode.calls, 2U);
+    EXPECT_EQ(st["InheritBase"].decode.bytes, 0U);
+#ifdef XPACK_INSTRUMENT_FIELD
+    EXPECT_EQ(st["InheritChild.c1"].decode.calls, 2U);
+    EXPECT_EQ(st["InheritBase.b2"].encode.calls, 1U);
+#endif
+
+    xpack::Instrument::Reset();
+    st = xpack::Instrument::Snapshot();
+    EXPECT_EQ(st["InheritChild"].decode.calls, 0U);
+}
+#endif
+
+// ++++++++++++++++++ xml stream writer ++++++++++++++++
+struct XmlLabel {
+    string lang;
+    string text;
+    XPACK(X(F(ATTR), lang), X(F(XML_CONTENT), text));
+};
+struct XmlStreamMix {
+    vector<XmlLabel> labels;
+    vector<FlagATTR> attrs;
+    vector<Base> sbs;
+    vector<int> empty;
+    vector<vector<int> > vv;
+    string cdata;
+    string esc;
+    Base one;
+    bool flag;
+    double d;
+    XPACK(O(labels, attrs), A(sbs, "xml:item,sbs", cdata, "xml:cd,cdata"), O(empty, vv, esc, one, flag, d));
+};
+template <class T>
+void checkXmlStream(const T &v) {
+    int indents[] = {-1, 0, 2};
+    for (size_t i=0; i<sizeof(indents)/sizeof(indents[0]); ++i) {
+        xpack::XmlEncoder tree(indents[i], ' ');
+        xpack::XmlEncoder stream(indents[i], ' ');
+        stream.SetStream(true);
+        EXPECT_EQ(tree.encode(v, "root"), stream.encode(v, "root"));
+    }
+}
+TEST(xml, stream) {
+    XmlStreamMix m;
+    XmlLabel l;
+    l.lang = "en";
+    l.text = "hello";
+    m.labels.push_back(l);
+    l.lang = "zh";
+    l.text = "";
+    m.labels.push_back(l);
+    FlagATTR fa;
+    fa.a = 1;
+    fa.b = "a<b";
+    m.attrs.push_back(fa);
+    m.sbs.push_back(Base(1, "x"));
+    m.sbs.push_back(Base(2, ""));
+    m.vv.resize(2);
+    m.vv[1].push_back(3);
+    m.cdata = "<raw>";
+    m.esc = "<&>\"'\x01";
+    m.one = Base(3, "y");
+    m.flag = true;
+    m.d = 1.5;
+    checkXmlStream(m);
+
+    checkXmlStream(XmlStreamMix());
+    checkXmlStream(5);
+    checkXmlStream(m.vv);
+
+    ContainerStruct cs;
+    cs.m["a"] = Base(1, "good");
+    cs.v.push_back(Base(3, "hello"));
+    cs.vv.resize(1);
+    cs.vv[0].push_back(Base(7, "lala"));
+    checkXmlStream(cs);
+
+    FlagVectorLabel fv;
+    fv.a.push_back(1);
+    fv.b.push_back(3);
+    fv.b.push_back(4);
+    fv.c.push_back(5);
+    checkXmlStream(fv);
+
+    xpack::XmlEncoder stream;
+    stream.SetStream(true);
+    EXPECT_EQ(stream.encode(fa, "root"), "<root b=\"a&lt;b\"><a>1</a></root>");
+}
+
+struct XmlMany {
+    int a0, a1, a2, a3, a4, a5, a6, a7, a8, a9;
+    int b0, b1, b2, b3, b4, b5, b6, b7, b8, b9;
+    XPACK(O(a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, b0, b1, b2, b3, b4, b5, b6, b7, b8, b9));
+};
+struct XmlDup {
+    int a;
+    int b;
+    XPACK(O(b, a));
+};
+TEST(xml, lookup) {
+    // less than X_PACK_XML_INDEX_THRESHOLD children, out of order
+    Base b;
+    xpack::xml::decode("<root><b>x</b><extra/><a>3</a></root>", b);
+    EXPECT_EQ(b.a, 3);
+    EXPECT_EQ(b.b, "x");
+
+    // hash index
+    std::string s = "<root>";
+    for (int i=9; i>=0; --i) {
+        s += "<b"+xpack::Util::itoa(i)+">"+xpack::Util::itoa(i+10)+"</b"+xpack::Util::itoa(i)+">";
+        s += "<a"+xpack::Util::itoa(i)+">"+xpack::Util::itoa(i)+"</a"+xpack::Util::itoa(i)+">";
+    }
+    s += "<a0>100</a0></root>";
+    XmlMany m;
+    xpack::xml::decode(s, m);
+    EXPECT_EQ(m.a0, 0);
+    EXPECT_EQ(m.a9, 9);
+    EXPECT_EQ(m.b0, 10);
+    EXPECT_EQ(m.b5, 15);
+    EXPECT_EQ(m.b9, 19);
+
+    // duplicated names, the first one wins on both sides of the threshold
+    XmlDup d1;
+    xpack::xml::decode("<root><a>1</a><b>2</b><a>3</a></root>", d1);
+    EXPECT_EQ(d1.a, 1);
+    EXPECT_EQ(d1.b, 2);
+    s = "<root><a>1</a><b>2</b><a>3</a>";
+    for (int i=0; i<X_PACK_XML_INDEX_THRESHOLD; ++i) {
+        s += "<x/>";
+    }
+    s += "</root>";
+    XmlDup d2;
+    xpack::xml::decode(s, d2);
+    EXPECT_EQ(d2.a, 1);
+    EXPECT_EQ(d2.b, 2);
+}
+
+struct XmlInplace {
+    int a;
+    string b;
+    string c;
+    double d;
+    XPACK(O(a), X(F(ATTR), b), O(c, d));
+};
+TEST(xml, inplace) {
+    const char *data = "<root b=\"a&amp;&#x4e2d;&#25991;\"><a>12</a><c>&lt;x&gt; &unknown;</c><d>1.5</d></root>";
+
+    XmlInplace v1;
+    xpack::xml::decode(data, v1); // read only
+    EXPECT_EQ(v1.a, 12);
+    EXPECT_EQ(v1.b, "a&\xe4\xb8\xad\xe6\x96\x87");
+    EXPECT_EQ(v1.c, "<x> &unknown;");
+    EXPECT_EQ(v1.d, 1.5);
+
+    XmlInplace v2;
+    std::string buf(data);
+    xpack::xml::decode_inplace(&buf[0], v2);
+    EXPECT_EQ(v2.a, v1.a);
+    EXPECT_EQ(v2.b, v1.b);
+    EXPECT_EQ(v2.c, v1.c);
+    EXPECT_EQ(v2.d, v1.d);
+}
+
+struct XmlRecord {
+    int id;
+    string name;
+    vector<int> v;
+    XPACK(O(id, name, v));
+};
+struct XmlRecordCounter {
+    vector<XmlRecord> *out;
+    void operator()(XmlRecord &r) {
+        out->push_back(r);
+    }
+};
+TEST(xml, reader) {
+    std::string doc = "<?xml version=\"1.0\"?>\n<!DOCTYPE feed [<!ENTITY x \"y\">]>\n<feed a=\"<record>\">"
+        "<!-- <record><id>9</id></record> --><head><record><id>8</id></record></head>"
+        "<record><id>1</id><name>a&amp;b</name><v><v>1</v><v>2</v></v></record>\n"
+        "<record attr='>'><id>2</id><name><![CDATA[</record>]]></name></record>"
+        "<record/><recordx><id>7</id></recordx>"
+        "<record><id>3</id></record></feed>\n";
+
+    for (size_t chunk=1; chunk<32; chunk+=5) {
+        std::istringstream is(doc);
+        xpack::XmlReader reader(is, "record", chunk);
+        vector<XmlRecord> rs;
+        for (;;) {
+            XmlRecord r;
+            if (!reader.next(r)) {
+                break;
+            }
+            rs.push_back(r);
+        }
+        EXPECT_EQ(rs.size(), 4U);
+        if (rs.size() == 4U) {
+            EXPECT_EQ(rs[0].id, 1);
+            EXPECT_EQ(rs[0].name, "a&b");
+            EXPECT_EQ(rs[0].v.size(), 2U);
+            EXPECT_EQ(rs[1].id, 2);
+            EXPECT_EQ(rs[3].id, 3);
+        }
+    }
+
+    std::istringstream is(doc);
+    vector<XmlRecord> rs;
+    XmlRecordCounter c;
+    c.out = &rs;
+    EXPECT_EQ(xpack::xml::for_each<XmlRecord>(is, "record", c), 4U);
+    EXPECT_EQ(rs[2].id, 0);
+
+    bool except = false;
+    std::istringstream bad("<feed><record><id>1</id>");
+    try {
+        xpack::xml::for_each<XmlRecord>(bad, "record", c);
+    } catch (const std::exception&e) {
+        except = true;
+    }
+    EXPECT_TRUE(except);
+}
+
+TEST(xml, escape) {
+    std::string raw;
+    std::string expect;
+    for (int i=0; i<300; ++i) {
+        char c = (char)('a'+i%26);
+        if (i%37 == 0) {
+            c = "<>&'\"\x01"[i%6];
+        } else if (i%41 == 0) {
+            c = (char)0xE4; // not ascii, no escape
+        }
+        raw.push_back(c);
+        switch (c) {
+          case '<': expect += "&lt;"; break;
+          case '>': expect += "&gt;"; break;
+          case '&': expect += "&amp;"; break;
+          case '\'': expect += "&apos;"; break;
+          case '"': expect += "&quot;"; break;
+          case '\x01': expect += "\\x01"; break;
+          default: expect.push_back(c);
+        }
+    }
+    std::string out;
+    xpack::XmlEscape::escape(out, raw.data(), raw.length());
+    EXPECT_EQ(out, expect);
+
+    std::string back;
+    std::string txt = "a&lt;&gt;&amp;&apos;&quot;&#65;&#x42;&#x;&bad;&";
+    xpack::XmlEscape::unescape(back, txt.data(), txt.length());
+    EXPECT_EQ(back, "a<>&'\"AB&#x;&bad;&");
+}
+
+struct FloatPrecision {
+    float f;
+    double d;
+    XPACK(O(f, d));
+};
+TEST(util, number) {
+    EXPECT_EQ(xpack::Util::dtoa(0.1), "0.1");
+    EXPECT_EQ(xpack::Util::dtoa(1.0), "1");
+    EXPECT_EQ(xpack::Util::dtoa(-2.5), "-2.5");
+    EXPECT_EQ(xpack::Util::dtoa(1.23456, 2), "1.23");
+    EXPECT_EQ(xpack::Util::dtoa(std::numeric_limits<double>::quiet_NaN()), "nan");
+    EXPECT_EQ(xpack::Util::dtoa(-std::numeric_limits<double>::infinity()), "-inf");
+
+    char buf[32];
+    *xpack::Util::itoa(std::numeric_limits<int64_t>::min(), buf) = '\0';
+    EXPECT_EQ(std::string(buf), "-9223372036854775808");
+    *xpack::Util::itoa(std::numeric_limits<uint64_t>::max(), buf) = '\0';
+    EXPECT_EQ(std::string(buf), "18446744073709551615");
+
+    int i = 0;
+    EXPECT_TRUE(xpack::Util::atoi("-123", 3, i));
+    EXPECT_EQ(i, -12);
+    EXPECT_FALSE(xpack::Util::atoi("+1", 1, i)); // bare sign, s[1] is not read
+    EXPECT_FALSE(xpack::Util::atoi("-1", 1, i));
+    EXPECT_EQ(i, -12);
+
+    FloatPrecision fp;
+    fp.f = 0.5f;
+    fp.d = 3.25;
+    EXPECT_EQ(xpack::xml::encode(fp, "root"), "<root><f>0.5</f><d>3.25</d></root>");
+}
+
+struct PlanColumns {
+    const char *names[3];
+    mutable int finds;
+    int find(const char *key) const {
+        ++finds;
+        for (int i=0; i<3; ++i) {
+            if (0 == strcmp(names[i], key)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+    const char *column(int idx) const {
+        return names[idx];
+    }
+};
+TEST(util, column_plan) {
+    PlanColumns cols = {{"a", "b", "c"}, 0};
+    xpack::ColumnPlan plan;
+    static const char *b = "b";
+    static const char *x = "x";
+    static const char *c = "c";
+    for (int row=0; row<3; ++row) {
+        plan.rewind();
+        EXPECT_EQ(plan.get(c, cols), 2);
+        EXPECT_EQ(plan.get(x, cols), -1);
+        EXPECT_EQ(plan.get(b, cols), 1);
+    }
+    EXPECT_EQ(cols.finds, 5); // x is checked again in each row
+
+    // reused on another result set where x exists
+    PlanColumns cols2 = {{"a", "x", "c"}, 0};
+    plan.rewind();
+    EXPECT_EQ(plan.get(c, cols2), 2);
+    EXPECT_EQ(plan.get(x, cols2), 1);
+    EXPECT_EQ(plan.get(b, cols2), -1);
+
+    plan.rewind(); // different order
+    EXPECT_EQ(plan.get(b, cols), 1);
+    EXPECT_EQ(cols.finds, 6);
+}
+
+TEST(util, datetime) {
+    int64_t sec = 0;
+    int usec = 0;
+    bool zone = false;
+    EXPECT_TRUE(xpack::Util::parse_datetime("2000-02-29T12:34:56.5+08:00", 27, sec, usec, zone));
+    EXPECT_EQ(sec, 951798896LL);
+    EXPECT_EQ(usec, 500000);
+    EXPECT_TRUE(zone);
+    EXPECT_TRUE(xpack::Util::parse_datetime("1600-02-29 23:30:00.1234567-00:30", 33, sec, usec, zone));
+    EXPECT_EQ(sec, -11670912000LL);
+    EXPECT_EQ(usec, 123456);
+    EXPECT_TRUE(xpack::Util::parse_datetime("2016-12-31 23:59:59", 19, sec, usec, zone));
+    EXPECT_EQ(sec, 1483228799LL);
+    EXPECT_TRUE(!zone);
+
+    const char *bad[] = {"2001-02-29T00:00:00Z", "2000-13-01T00:00:00Z", "2000-01-01T24:00:00Z", "2000-01-01T00:00:00.Z",
+                         "2000-01-01T00:00:00+0800", "2000-01-01T00:00:00Zx", "2000-01-01", "0000-00-00 00:00:00"};
+    for (size_t i=0; i<sizeof(bad)/sizeof(bad[0]); ++i) {
+        EXPECT_TRUE(!xpack::Util::parse_datetime(bad[i], strlen(bad[i]), sec, usec, zone));
+    }
+
+    char buf[32];
+    EXPECT_EQ(xpack::Util::format_datetime(951798896789LL, buf), 24U);
+    EXPECT_EQ(std::string(buf), "2000-02-29T04:34:56.789Z");
+    xpack::Util::format_datetime(-1, buf);
+    EXPECT_EQ(std::string(buf), "1969-12-31T23:59:59.999Z");
+    xpack::Util::format_datetime(0, buf);
+    EXPECT_EQ(std::string(buf), "1970-01-01T00:00:00Z");
+
+    // same as mktime in any time zone
+    xpack::LocalTime lt;
+    for (int64_t local = 946684800LL; local < 978307200LL; local += 43200+1234) {
+        struct tm t;
+        memset(&t, 0, sizeof(t));
+        int64_t days = local/86400;
+        int64_t y;
+        unsigned m, d;
+        xpack::Util::civil_from_days(days, y, m, d);
+        t.tm_year = (int)y-1900;
+        t.tm_mon = (int)m-1;
+        t.tm_mday = (int)d;
+        t.tm_hour = (int)(local%86400/3600);
+        t.tm_min = (int)(local%3600/60);
+        t.tm_sec = (int)(local%60);
+        t.tm_isdst = -1;
+        time_t expect = mktime(&t);
+        if (t.tm_hour != (int)(local%86400/3600)) {
+            continue; // in the gap of daylight saving
+        }
+        EXPECT_EQ(lt.to_utc(local), (int64_t)expect);
+    }
+}
+
 // ++++++++++++++++++bug history+++++++++++++++++++++++
 TEST(bughis, notexists) {
     Base b(9, "");
@@ -0,0 +1,250 @@
+/*
+* Copyright (C) 2021 Duowan Inc. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+// need yaml-cpp
+
+#include <iostream>
+#ifdef XGTEST
+#include<gtest/gtest.h>
+#else
+#include "gtest_stub.h"
+#endif
+
+#include "xpack/yaml.h"
+#include "string.h"
+
+using namespace std;
+
+struct Base {
+    int    a;
+    string b;
+    Base(const int _a=0, const string&_b=""):a(_a), b(_b){}
+    XPACK(O(a, b));
+};
+
+// ++++++++++++++++++++++BuiltInTypes++++++++++++++++++++++++++++
+struct BuiltInTypes {
+    signed char        sch;
+    char               ch;
+    short              sh;
+    unsigned short     ush;
+    int                i;
+    unsigned int       ui;
+    long long          ll;
+    unsigned long long ull;
+    float              f;
+    double             d;
+    long double        ld;
+    bool               b;
+    XPACK(O(sch, ch, sh, ush, i, ui, ll, ull, f, d, ld, b));
+};
+
+TEST(builtin, types) {
+    BuiltInTypes bt;
+    bt.sch = -0x7f;
+    bt.ch = 'x';
+    bt.sh = 0x7fff;
+    bt.ush = 0x8000;
+    bt.i = -0x7fffffff;
+    bt.ui = 0x80000000;
+    bt.ll = -0x7fffffffffffffffLL;
+    bt.ull = 0x8000000000000000ULL;
+    bt.f = 1.234f;
+    bt.d = 9.678;
+    bt.ld = 30.678;
+    bt.b = true;
+
+    BuiltInTypes y;
+    xpack::yaml::decode(xpack::yaml::encode(bt), y);
+    EXPECT_EQ(y.sch, bt.sch);
+    EXPECT_EQ(y.ch, bt.ch);
+    EXPECT_EQ(y.sh, bt.sh);
+    EXPECT_EQ(y.ush, bt.ush);
+    EXPECT_EQ(y.i, bt.i);
+    EXPECT_EQ(y.ui, bt.ui);
+    EXPECT_EQ(y.ll, bt.ll);
+    EXPECT_EQ(y.ull, bt.ull);
+    EXPECT_FLOAT_EQ(y.f, bt.f);
+    EXPECT_DOUBLE_EQ(y.d, bt.d);
+    EXPECT_DOUBLE_EQ(y.ld, bt.ld);
+    EXPECT_TRUE(y.b);
+}
+
+// same rules as YAML::Node::as
+TEST(scalar, convert) {
+    BuiltInTypes y;
+    xpack::yaml::decode("i: 0x10\nui: 010\nsh: '-3'\nd: -.Inf\nf: 1e3\nb: OFF\nch: z\n", y);
+    EXPECT_EQ(y.i, 16);
+    EXPECT_EQ(y.ui, 8U);
+    EXPECT_EQ(y.sh, -3);
+    EXPECT_TRUE(y.d < 0 && y.d*2 == y.d);
+    EXPECT_FLOAT_EQ(y.f, 1000.0f);
+    EXPECT_TRUE(!y.b);
+    EXPECT_EQ(y.ch, 'z');
+
+    const char *bad[] = {"ui: -1", "sh: 70000", "b: oN", "i: 1.5", "d: 1e500", "i: [1]", "ch: zz"};
+    for (size_t i=0; i<sizeof(bad)/sizeof(bad[0]); ++i) {
+        bool except = false;
+        try {
+            xpack::yaml::decode(bad[i], y);
+        } catch (const std::exception&e) {
+            except = NULL != strstr(e.what(), "bad conversion");
+        }
+        EXPECT_TRUE(except);
+    }
+
+    Base b;
+    xpack::yaml::decode("b: ~", b);
+    EXPECT_EQ(b.b, "null");
+}
+
+// ++++++++++++++++++++ container +++++++++++++++++++++
+struct Container {
+    vector<Base> v;
+    map<string, vector<int> > m;
+    list<string> l;
+    Base o;
+    int missing;
+    XPACK(O(v, m, l, o, missing));
+};
+
+TEST(container, base) {
+    Container c;
+    c.missing = 5;
+    string s = "o: {b: ob, a: 3}\n"
+               "v:\n  - &base {a: 1, b: x}\n  - *base\n  - a: 2\n"
+               "l: [p, q]\n"
+               "m:\n  k1: [1, 2, 3]\n  k2: []\n";
+    xpack::yaml::decode(s, c);
+    EXPECT_EQ(c.v.size(), 3U);
+    EXPECT_EQ(c.v[1].a, 1);
+    EXPECT_EQ(c.v[1].b, "x");
+    EXPECT_EQ(c.v[2].a, 2);
+    EXPECT_EQ(c.m.size(), 2U);
+    EXPECT_EQ(c.m["k1"].size(), 3U);
+    EXPECT_EQ(c.m["k1"][2], 3);
+    EXPECT_EQ(c.l.size(), 2U);
+    EXPECT_EQ(c.l.back(), "q");
+    EXPECT_EQ(c.o.a, 3);
+    EXPECT_EQ(c.o.b, "ob");
+    EXPECT_EQ(c.missing, 5);
+
+    Container c1;
+    c.v[2].b = "y";
+    xpack::yaml::decode(xpack::yaml::encode(c), c1);
+    EXPECT_EQ(xpack::yaml::encode(c1), xpack::yaml::encode(c));
+
+    bool except = false;
+    try {
+        xpack::yaml::decode("v: 3", c1);
+    } catch (const std::exception&e) {
+        except = NULL != strstr(e.what(), "not sequence");
+    }
+    EXPECT_TRUE(except);
+}
+
+struct YamlDup {
+    int a;
+    int b;
+    XPACK(O(b, a));
+};
+TEST(map, duplicated) {
+    // the first one wins as YAML::Node, on both sides of X_PACK_YAML_CURSOR_THRESHOLD
+    string s = "a: 1\nb: 2\na: 3\n";
+    YamlDup d1;
+    xpack::yaml::decode(s, d1);
+    EXPECT_EQ(d1.a, 1);
+    EXPECT_EQ(d1.b, 2);
+
+    YamlDup d0;
+    xpack::YamlDecoder de;
+    de.decode(YAML::Load(s), d0);
+    EXPECT_EQ(d0.a, d1.a);
+
+    for (int i=0; i<X_PACK_YAML_CURSOR_THRESHOLD; ++i) {
+        s += "x"+xpack::Util::itoa(i)+": 0\n";
+    }
+    YamlDup d2;
+    xpack::yaml::decode(s, d2);
+    EXPECT_EQ(d2.a, 1);
+    EXPECT_EQ(d2.b, 2);
+}
+
+struct DocCollector {
+    vector<Base> *docs;
+    void operator()(Base &b) {
+        docs->push_back(b);
+    }
+};
+TEST(multidoc, base) {
+    vector<Base> docs;
+    DocCollector c;
+    c.docs = &docs;
+    string s = "a: 1\nb: x\n---\na: 2\n---\n---\nb: z\n...\n";
+    EXPECT_EQ(xpack::yaml::decode_all<Base>(s, c), 4U);
+    EXPECT_EQ(docs.size(), 4U);
+    EXPECT_EQ(docs[0].a, 1);
+    EXPECT_EQ(docs[0].b, "x");
+    EXPECT_EQ(docs[1].a, 2);
+    EXPECT_EQ(docs[1].b, ""); // reset between documents
+    EXPECT_EQ(docs[2].a, 0);
+    EXPECT_EQ(docs[3].b, "z");
+
+    std::istringstream is("");
+    EXPECT_EQ(xpack::yaml::decode_all<Base>(is, c), 0U);
+}
+
+// same layout as YAML::Emitter
+TEST(writer, format) {
+    Container c;
+    c.v.push_back(Base(1, "x y"));
+    c.m["k"].push_back(2);
+    c.m["e"];
+    c.l.push_back("a: b");
+    c.l.push_back("");
+    c.o.a = 3;
+    c.o.b = "-";
+    c.missing = 4;
+    string s = "v:\n  - a: 1\n    b: x y\nm:\n  e:\n    []\n  k:\n    - 2\nl:\n  - \"a: b\"\n  - ~\no:\n  a: 3\n  b: \"-\"\nmissing: 4";
+    EXPECT_EQ(xpack::yaml::encode(c), s);
+    EXPECT_EQ(xpack::YamlEncoder().SetIndent(4).encode(c.v), "-   a:  1\n    b:  x y");
+
+    const char *strs[] = {"null", "~", " x", "x ", "x: y", "x:", "a #b", "#a", "- a", "---", "[a", "\"q\\", "t\tn\nr\r\x01"};
+    vector<string> v(strs, strs+sizeof(strs)/sizeof(strs[0]));
+    vector<string> v1;
+    xpack::yaml::decode(xpack::yaml::encode(v), v1);
+    EXPECT_TRUE(v1 == v);
+}
+
+TEST(yamlnode, base) {
+    Base b;
+    xpack::YamlDecoder de;
+    de.decode(YAML::Load("a: 7\nb: node"), b);
+    EXPECT_EQ(b.a, 7);
+    EXPECT_EQ(b.b, "node");
+}
+
+int main(int argc, char *argv[]) {
+#ifdef XGTEST
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+#else
+    (void)argc;
+    (void)argv;
+    TC_CONTAINER::RUN();
+    return 0;
+#endif
+}
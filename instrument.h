@@ -0,0 +1,200 @@
+/*
+* Copyright (C) 2021 Duowan Inc. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef __X_PACK_INSTRUMENT_H
+#define __X_PACK_INSTRUMENT_H
+
+#include "config.h"
+#include "traits.h"
+
+/*
+  decode/encode statistics, define XPACK_INSTRUMENT(need c++11) to enable it.
+  - per struct type: calls, time(inclusive, nested struct is counted in its parent too),
+    bytes(only for the top level type of xpack::json/xml/yaml/bson decode/encode)
+  - define XPACK_INSTRUMENT_FIELD too for per member statistics, key is "Type.member"
+  without XPACK_INSTRUMENT all the hooks expand to nothing.
+
+  xpack::InstrumentSnapshot s = xpack::Instrument::Snapshot();
+  s["User"].decode.calls ...
+*/
+
+#ifdef XPACK_INSTRUMENT
+
+#ifndef X_PACK_SUPPORT_CXX0X
+#error "XPACK_INSTRUMENT need c++11"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <stdint.h>
+
+#ifdef __GNUC__
+#include <cstdlib>
+#include <cxxabi.h>
+#endif
+
+namespace xpack {
+
+struct InstrumentCounter {
+    uint64_t calls;
+    uint64_t nanos;
+    uint64_t bytes;
+    InstrumentCounter():calls(0), nanos(0), bytes(0){}
+};
+
+struct InstrumentStat {
+    InstrumentCounter decode;
+    InstrumentCounter encode;
+};
+
+typedef std::map<std::string, InstrumentStat> InstrumentSnapshot;
+
+class Instrument {
+public:
+    enum {DECODE=0, ENCODE=1};
+
+    struct Counter {
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> nanos;
+        std::atomic<uint64_t> bytes;
+        Counter():calls(0), nanos(0), bytes(0){}
+    };
+
+    // counter of struct type, the pointer is valid for the whole program
+    template <class T>
+    static Counter* Type(int dir) {
+        static Counter* c = Entry(TypeName<T>());
+        return c + dir;
+    }
+    template <class T>
+    static Counter* Field(const T&, const char *field, int dir) {
+        return Entry(TypeName<T>()+"."+field) + dir;
+    }
+
+    static InstrumentSnapshot Snapshot() {
+        InstrumentSnapshot s;
+        std::lock_guard<std::mutex> lock(Mutex());
+        std::map<std::string, Counters>& ents = Entries();
+        for (std::map<std::string, Counters>::iterator it = ents.begin(); it != ents.end(); ++it) {
+            InstrumentStat &st = s[it->first];
+            Load(st.decode, it->second.c[DECODE]);
+            Load(st.encode, it->second.c[ENCODE]);
+        }
+        return s;
+    }
+    // set all counters to 0, the entries are kept
+    static void Reset() {
+        std::lock_guard<std::mutex> lock(Mutex());
+        std::map<std::string, Counters>& ents = Entries();
+        for (std::map<std::string, Counters>::iterator it = ents.begin(); it != ents.end(); ++it) {
+            for (int i=0; i<2; ++i) {
+                it->second.c[i].calls = 0;
+                it->second.c[i].nanos = 0;
+                it->second.c[i].bytes = 0;
+            }
+        }
+    }
+
+    static void AddBytes(Counter *c, size_t bytes) {
+        c->bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+private:
+    struct Counters {
+        Counter c[2];
+    };
+
+    template <class T>
+    static std::string TypeName() {
+        std::string name(typeid(T).name());
+    #ifdef __GNUC__
+        int status = 0;
+        char *dm = abi::__cxa_demangle(name.c_str(), NULL, NULL, &status);
+        if (NULL != dm) {
+            if (0 == status) {
+                name = dm;
+            }
+            free(dm);
+        }
+    #endif
+        return name;
+    }
+
+    static Counter* Entry(const std::string &name) {
+        std::lock_guard<std::mutex> lock(Mutex());
+        return Entries()[name].c; // map node never move
+    }
+    static void Load(InstrumentCounter &dst, const Counter &src) {
+        dst.calls = src.calls.load(std::memory_order_relaxed);
+        dst.nanos = src.nanos.load(std::memory_order_relaxed);
+        dst.bytes = src.bytes.load(std::memory_order_relaxed);
+    }
+    static std::mutex& Mutex() {
+        static std::mutex m;
+        return m;
+    }
+    static std::map<std::string, Counters>& Entries() {
+        static std::map<std::string, Counters> ents;
+        return ents;
+    }
+};
+
+// count one call and its time
+class InstrumentScope {
+public:
+    InstrumentScope(Instrument::Counter *c):_c(c), _start(std::chrono::steady_clock::now()) {}
+    ~InstrumentScope() {
+        uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+        _c->calls.fetch_add(1, std::memory_order_relaxed);
+        _c->nanos.fetch_add(ns, std::memory_order_relaxed);
+    }
+private:
+    Instrument::Counter *_c;
+    std::chrono::steady_clock::time_point _start;
+};
+
+}
+
+// DIR is DECODE or ENCODE
+#define X_PACK_INSTRUMENT_TYPE(DIR, T)                                                                  \
+    static xpack::Instrument::Counter *__x_pack_icnt = xpack::Instrument::Type<T>(xpack::Instrument::DIR); \
+    xpack::InstrumentScope __x_pack_iscope(__x_pack_icnt);
+
+#define X_PACK_INSTRUMENT_BYTES(DIR, T, N) \
+    xpack::Instrument::AddBytes(xpack::Instrument::Type<T>(xpack::Instrument::DIR), N);
+
+#ifdef XPACK_INSTRUMENT_FIELD
+// used in __x_pack_decode/__x_pack_encode
+#define X_PACK_INSTRUMENT_FIELD(DIR, M)                                                                          \
+    static xpack::Instrument::Counter *__x_pack_ifcnt = xpack::Instrument::Field(__x_pack_self, #M, xpack::Instrument::DIR); \
+    xpack::InstrumentScope __x_pack_ifscope(__x_pack_ifcnt);
+#else
+#define X_PACK_INSTRUMENT_FIELD(DIR, M)
+#endif
+
+#else
+
+#define X_PACK_INSTRUMENT_TYPE(DIR, T)
+#define X_PACK_INSTRUMENT_BYTES(DIR, T, N)
+#define X_PACK_INSTRUMENT_FIELD(DIR, M)
+
+#endif
+
+#endif
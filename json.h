@@ -30,6 +30,7 @@ class json {
 public:
     template <class T>
     static void decode(const std::string &data, T &val) {
+        X_PACK_INSTRUMENT_BYTES(DECODE, T, data.size())
         JsonDecoder de;
         de.decode(data, val);
     }
@@ -44,17 +45,28 @@ public:
         de.decode_file(file_name, val);
     }
 
+    // update val in place with a json merge patch(RFC 7396)
+    template <class T>
+    static void apply_patch(const std::string &patch, T &val) {
+        JsonDecoder de;
+        de.patch(patch, val);
+    }
+
     template <class T>
     static std::string encode(const T &val) {
         JsonEncoder en;
-        return en.encode(val);
+        std::string s = en.encode(val);
+        X_PACK_INSTRUMENT_BYTES(ENCODE, T, s.size())
+        return s;
     }
 
     template <class T>
     static std::string encode(const T &val, int flag, int indentCount, char indentChar) {
         (void)flag;
         JsonEncoder en(indentCount, indentChar);
-        return en.encode(val);
+        std::string s = en.encode(val);
+        X_PACK_INSTRUMENT_BYTES(ENCODE, T, s.size())
+        return s;
     }
 };
 
@@ -17,6 +17,7 @@
 #ifndef __X_PACK_JSON_DECODER_H
 #define __X_PACK_JSON_DECODER_H
 
+#include <cstring>
 #include <fstream>
 
 #include "rapidjson_custom.h"
@@ -26,6 +27,11 @@
 #include "xdecoder.h"
 #include "json_data.h"
 
+// Find tries the member after last hit only if the object has no more members than it
+#ifndef X_PACK_JSON_CURSOR_THRESHOLD
+#define X_PACK_JSON_CURSOR_THRESHOLD 16
+#endif
+
 
 namespace xpack {
 
@@ -35,11 +41,11 @@ class JsonNode {
 public:
     typedef rapidjson::Value::ConstMemberIterator Iterator;
 
-    JsonNode(const rapidjson::Value* val=NULL):v(val){}
+    JsonNode(const rapidjson::Value* val=NULL):v(val),next(0),dup(-1){}
 
     // convert JsonData to JsonNode
     // The life cycle of jd cannot be shorter than JsonNode
-    JsonNode(const JsonData&jd):v(jd.current){}
+    JsonNode(const JsonData&jd):v(jd.current),next(0),dup(-1){}
 
     inline static const char * Name() {
         return "json";
@@ -57,8 +63,28 @@ public:
         } else if (!v->IsObject()) {
             de.decode_exception("not object", NULL);
         }
-        rapidjson::Value::ConstMemberIterator iter = v->FindMember(key);
+        /*
+          members are usually in declaration order, try the one after last hit first.
+          FindMember returns the first one if names are duplicated, so the cursor is only
+          used for a few members with distinct names, which are checked at the first lookup
+        */
+        size_t len = strlen(key);
+        Iterator begin = v->MemberBegin();
+        if (dup < 0) {
+            dup = this->duplicated() ? 1 : 0;
+        }
+        if (0 == dup && next < v->MemberCount()) {
+            Iterator iter = begin + next;
+            if (iter->name.GetStringLength() == len && 0 == memcmp(iter->name.GetString(), key, len)) {
+                ++next;
+                return JsonNode(&iter->value);
+            }
+        }
+
+        rapidjson::Value name(rapidjson::StringRef(key, (rapidjson::SizeType)len));
+        rapidjson::Value::ConstMemberIterator iter = v->FindMember(name);
         if (iter != v->MemberEnd()) {
+            next = (rapidjson::SizeType)(iter - begin) + 1;
             return JsonNode(&iter->value);
         } else {
             return JsonNode();
@@ -155,8 +181,27 @@ public:
     }
 
 private:
+    bool duplicated() const {
+        rapidjson::SizeType num = v->MemberCount();
+        if (num > X_PACK_JSON_CURSOR_THRESHOLD) {
+            return true; // too many to check, use FindMember only
+        }
+        Iterator begin = v->MemberBegin();
+        for (rapidjson::SizeType i=0; i<num; ++i) {
+            const rapidjson::Value &a = begin[i].name;
+            for (rapidjson::SizeType j=i+1; j<num; ++j) {
+                const rapidjson::Value &b = begin[j].name;
+                if (a.GetStringLength() == b.GetStringLength() && 0 == memcmp(a.GetString(), b.GetString(), a.GetStringLength())) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
     const rapidjson::Value* v;
-    rapidjson::Value::ConstMemberIterator iter;
+    mutable rapidjson::SizeType next; // cursor of Find
+    mutable signed char dup;          // -1: not checked, 1: duplicated names or too many members, the cursor is not used
 };
 
 class JsonDecoder {
@@ -179,6 +224,16 @@ public:
         }
         return ret;
     }
+    // apply json merge patch(RFC 7396) to val, see XDecoder::patch
+    template <class T>
+    bool patch(const std::string&str, T&val) {
+        rapidjson::Document doc;
+        if (this->parse(str, doc)) {
+            JsonNode node(&doc);
+            return XDecoder<JsonNode>(NULL, (const char*)NULL, node).patch(val, NULL);
+        }
+        return false;
+    }
 private:
     bool parse(const std::string&data, rapidjson::Document &doc) {
         std::string err;
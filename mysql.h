@@ -18,6 +18,7 @@
 #define __X_PACK_MYSQL_H
 
 #include "mysql_decoder.h"
+#include "mysql_stmt_decoder.h"
 #include "xpack.h"
 
 namespace xpack {
@@ -37,6 +38,26 @@ public:
         MySQLDecoder de(result);
         de.decode_column(field.c_str(), val, NULL);
     }
+
+    // decode rows one by one and call f(T&) for each, return the count.
+    // result can be from mysql_use_result, so the rows are never all held in memory
+    template <class T, class F>
+    static size_t for_each(MYSQL_RES *result, F f) {
+        MySQLDecoder de(result, false);
+        return decode_each<T>(de, f);
+    }
+
+    // convert the result of an executed prepared statement to a struct or vector<struct>, rows are fetched in binary protocol
+    template <class T>
+    static void decode(MYSQL_STMT *stmt, T &val) {
+        MySQLStmtDecoder de(stmt);
+        de.decode_top(val, NULL);
+    }
+    template <class T, class F>
+    static size_t for_each(MYSQL_STMT *stmt, F f) {
+        MySQLStmtDecoder de(stmt);
+        return decode_each<T>(de, f);
+    }
 };
 
 }
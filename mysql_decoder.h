@@ -26,6 +26,7 @@
 #include <mysql/mysql.h>
 
 #include "extend.h"
+#include "instrument.h"
 #include "traits.h"
 #include "json.h"
 
@@ -41,10 +42,11 @@ struct is_xpack_mysql_xtype {static bool const value = false;};
 
 class MySQLDecoder {
     friend class mysql;
+    friend class ColumnPlan;
 public:
     template <typename T>
     bool decode(const char*key, T&val, const Extend *ext) {
-        int idx = find(key);
+        int idx = _plan.get(key, *this);
         if (idx >= 0) {
             return this->decode_type(idx, val, ext);
         }
@@ -53,23 +55,46 @@ public:
     const char *Name() const {
         return "db";
     }
+    // decode the next row to a struct, return false if no more row. for decode_each
+    template <class T>
+    bool next(T &val) {
+        return this->decode_top(val, NULL);
+    }
 
 private:
     MYSQL_RES *_res;
     MYSQL_ROW _row;
     std::map<const char*, int, cmp_str> _index;
+    ColumnPlan _plan;
+    LocalTime _local;
 
-    MySQLDecoder(MYSQL_RES *result):_res(result), _row(NULL) {
-        mysql_data_seek(_res, 0);  // reset cursor to head
+    // seek is false for the result of mysql_use_result, which can't seek
+    MySQLDecoder(MYSQL_RES *result, bool seek = true):_res(result), _row(NULL) {
+        if (seek) {
+            mysql_data_seek(_res, 0);  // reset cursor to head
+        }
         for (int i=0; i<int(result->field_count); ++i) {
             _index[result->fields[i].name] = i;
         }
     }
 
+    // fetch next row, return false if no more row. NULL is also returned on error of mysql_use_result
+    bool fetch() {
+        if (NULL != (_row = mysql_fetch_row(_res))) {
+            _plan.rewind();
+            return true;
+        }
+        if (NULL != _res->handle && 0 != mysql_errno(_res->handle)) {
+            throw std::runtime_error(std::string("mysql: ")+mysql_error(_res->handle));
+        }
+        return false;
+    }
+
     // decode to struct
     template <class T>
     inline XPACK_IS_XPACK(T) decode_top(T& val, const Extend *ext) {
-        if (NULL != (_row = mysql_fetch_row(_res))) {
+        if (fetch()) {
+            X_PACK_INSTRUMENT_TYPE(DECODE, T)
             val.__x_pack_decode(*this, val, ext);
             return true;
         }
@@ -77,23 +102,25 @@ private:
     }
     template <class T>
     inline XPACK_IS_XPACK(T) decode_top(std::vector<T>& val, const Extend *ext) {
-        while (NULL != (_row = mysql_fetch_row(_res))) {
+        while (fetch()) {
             val.push_back(T());
             T& tmp = val.back();
+            X_PACK_INSTRUMENT_TYPE(DECODE, T)
             tmp.__x_pack_decode(*this, tmp, ext);
         }
         return true;
     }
     template <class T>
     inline XPACK_IS_XOUT(T) decode_top(T& val, const Extend *ext) {
-        if (NULL != (_row = mysql_fetch_row(_res))) {
+        if (fetch()) {
             __x_pack_decode_out(*this, val, ext);
+            return true;
         }
-        return true;
+        return false;
     }
     template <class T>
     inline XPACK_IS_XOUT(T) decode_top(std::vector<T>& val, const Extend *ext) {
-        while (NULL != (_row = mysql_fetch_row(_res))) {
+        while (fetch()) {
             val.push_back(T());
             __x_pack_decode_out(*this, val.back(), ext);
         }
@@ -116,7 +143,7 @@ private:
         if (0 > (idx = find(field))) {
             return false;
         }
-        while (NULL != (_row = mysql_fetch_row(_res))) {
+        while (fetch()) {
             T t;
             decode_type(idx, t, ext);
             val.push_back(t);
@@ -125,6 +152,9 @@ private:
     }
 
 
+    const char *column(int idx) const {
+        return _res->fields[idx].name;
+    }
     int find(const char*field) const {
         std::map<const char*, int, cmp_str>::const_iterator it = _index.find(field);
         if (it != _index.end()) {
@@ -150,7 +180,10 @@ private:
     // unsigned integer. DATE and TIME use signed plz
     template <class T>
     typename x_enable_if<numeric<T>::is_integer && !numeric<T>::is_signed, bool>::type decode_type(const int idx, T &val, const Extend *ext) {
-        val = (T)std::strtoul(_row[idx], NULL, 10);
+        const char *str = _row[idx];
+        if (!Util::atoi(str, val)) { // not plain digits, such as DECIMAL 12.50
+            val = (NULL == str) ? 0 : (T)std::strtoul(str, NULL, 10);
+        }
         return true;
     }
     // signed integer
@@ -180,13 +213,20 @@ private:
             break;
         case MYSQL_TYPE_DATETIME:
         case MYSQL_TYPE_TIMESTAMP:{ // parse to unix timestamp, seconds, discard fractional part
-                tm t;
-                strptime(str, "%F %T", &t);
-                val = (T)mktime(&t);
+                int64_t sec;
+                int usec;
+                bool zone;
+                if (Util::parse_datetime(str, strlen(str), sec, usec, zone)) {
+                    val = (T)_local.to_utc(sec); // same as mktime, value is local time
+                } else {
+                    val = 0; // such as 0000-00-00 00:00:00
+                }
             }
             break;
         default:
-            val = (T)std::strtol(str, NULL, 10);
+            if (!Util::atoi(str, val)) { // not plain digits, such as DECIMAL 12.50
+                val = (T)std::strtol(str, NULL, 10);
+            }
         }
         return true;
     }
@@ -0,0 +1,387 @@
+/*
+* Copyright (C) 2021 Duowan Inc. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef __X_PACK_MYSQL_STMT_DECODER_H
+#define __X_PACK_MYSQL_STMT_DECODER_H
+
+#include <stdexcept>
+#include <map>
+#include <vector>
+#include <cstdlib>
+
+#include <mysql/mysql.h>
+
+#include "extend.h"
+#include "instrument.h"
+#include "traits.h"
+#include "json.h"
+#include "mysql_decoder.h"
+
+#include "string.h"
+#include "stdio.h"
+
+namespace xpack {
+
+// my_bool is removed since mysql 8.0.1
+#if !defined(MARIADB_BASE_VERSION) && !defined(MARIADB_PACKAGE_VERSION_ID) && defined(MYSQL_VERSION_ID) && MYSQL_VERSION_ID >= 80001
+typedef bool x_mysql_bool;
+#else
+typedef my_bool x_mysql_bool;
+#endif
+
+/*
+  decode the result of an executed prepared statement(MYSQL_STMT). rows come in binary protocol,
+  integer/float columns are bound as int64/double and date time columns as MYSQL_TIME,
+  so no text conversion is needed for them. other columns are bound as string.
+*/
+class MySQLStmtDecoder:private noncopyable {
+    friend class mysql;
+    friend class ColumnPlan;
+public:
+    template <typename T>
+    bool decode(const char*key, T&val, const Extend *ext) {
+        int idx = _plan.get(key, *this);
+        if (idx >= 0 && !_cols[idx].is_null) {
+            return this->decode_type(idx, val, ext);
+        }
+        return false;
+    }
+    const char *Name() const {
+        return "db";
+    }
+    // decode the next row to a struct, return false if no more row. for decode_each
+    template <class T>
+    bool next(T &val) {
+        return this->decode_top(val, NULL);
+    }
+
+private:
+    struct Column {
+        long long i;
+        double d;
+        MYSQL_TIME t;
+        std::vector<char> str;
+        unsigned long length;
+        x_mysql_bool is_null;
+        x_mysql_bool error;
+    };
+
+    MYSQL_STMT *_stmt;
+    MYSQL_RES *_meta;
+    MYSQL_FIELD *_fields;
+    std::vector<Column> _cols;
+    std::vector<MYSQL_BIND> _binds;
+    std::map<const char*, int, cmp_str> _index;
+    ColumnPlan _plan;
+    bool _rebind;       // string buffer grown, bind again before next fetch
+    LocalTime _local;
+
+    MySQLStmtDecoder(MYSQL_STMT *stmt):_stmt(stmt), _meta(mysql_stmt_result_metadata(stmt)), _rebind(false) {
+        if (NULL == _meta) {
+            throw std::runtime_error("mysql stmt: no result set");
+        }
+        try {
+            this->init();
+        } catch (...) { // the destructor is not called
+            mysql_free_result(_meta);
+            throw;
+        }
+    }
+    ~MySQLStmtDecoder() {
+        mysql_free_result(_meta);
+    }
+
+    // bind a buffer of each column
+    void init() {
+        _fields = mysql_fetch_fields(_meta);
+        int num = (int)mysql_num_fields(_meta);
+        _cols.resize(num);
+        _binds.resize(num);
+        for (int i=0; i<num; ++i) {
+            _index[_fields[i].name] = i;
+
+            Column &c = _cols[i];
+            MYSQL_BIND &b = _binds[i];
+            memset((void*)&b, 0, sizeof(b));
+            b.length = &c.length;
+            b.is_null = &c.is_null;
+            b.error = &c.error;
+            switch (_fields[i].type) {
+            case MYSQL_TYPE_TINY:
+            case MYSQL_TYPE_SHORT:
+            case MYSQL_TYPE_INT24:
+            case MYSQL_TYPE_LONG:
+            case MYSQL_TYPE_LONGLONG:
+            case MYSQL_TYPE_YEAR:
+                b.buffer_type = MYSQL_TYPE_LONGLONG;
+                b.buffer = &c.i;
+                b.is_unsigned = (0 != (_fields[i].flags & UNSIGNED_FLAG));
+                break;
+            case MYSQL_TYPE_FLOAT:
+            case MYSQL_TYPE_DOUBLE:
+                b.buffer_type = MYSQL_TYPE_DOUBLE;
+                b.buffer = &c.d;
+                break;
+            case MYSQL_TYPE_DATE:
+            case MYSQL_TYPE_TIME:
+            case MYSQL_TYPE_DATETIME:
+            case MYSQL_TYPE_TIMESTAMP:
+                b.buffer_type = _fields[i].type;
+                b.buffer = &c.t;
+                break;
+            default: // grown on truncation
+                b.buffer_type = MYSQL_TYPE_STRING;
+                c.str.resize((_fields[i].length > 0 && _fields[i].length < 256) ? _fields[i].length+1 : 256);
+                b.buffer = &c.str[0];
+                b.buffer_length = c.str.size()-1; // room for '\0'
+            }
+        }
+        bind();
+    }
+
+    void bind() {
+        if (!_binds.empty() && 0 != mysql_stmt_bind_result(_stmt, &_binds[0])) {
+            throw std::runtime_error(std::string("mysql stmt: ")+mysql_stmt_error(_stmt));
+        }
+        _rebind = false;
+    }
+    // fetch next row, return false if no more row
+    bool fetch() {
+        if (_rebind) {
+            bind();
+        }
+        int ret = mysql_stmt_fetch(_stmt);
+        if (MYSQL_NO_DATA == ret) {
+            return false;
+        } else if (0 != ret && MYSQL_DATA_TRUNCATED != ret) {
+            throw std::runtime_error(std::string("mysql stmt: ")+mysql_stmt_error(_stmt));
+        }
+        for (size_t i=0; i<_cols.size(); ++i) {
+            Column &c = _cols[i];
+            MYSQL_BIND &b = _binds[i];
+            if (MYSQL_TYPE_STRING != b.buffer_type || c.is_null) {
+                continue;
+            }
+            if (c.length > b.buffer_length) {
+                c.str.resize(c.length+1);
+                b.buffer = &c.str[0];
+                b.buffer_length = c.length;
+                if (0 != mysql_stmt_fetch_column(_stmt, &b, (unsigned int)i, 0)) {
+                    throw std::runtime_error(std::string("mysql stmt: ")+mysql_stmt_error(_stmt));
+                }
+                _rebind = true;
+            }
+            c.str[c.length] = '\0';
+        }
+        _plan.rewind();
+        return true;
+    }
+
+    template <class T>
+    inline XPACK_IS_XPACK(T) decode_top(T& val, const Extend *ext) {
+        if (fetch()) {
+            X_PACK_INSTRUMENT_TYPE(DECODE, T)
+            val.__x_pack_decode(*this, val, ext);
+            return true;
+        }
+        return false;
+    }
+    template <class T>
+    inline XPACK_IS_XPACK(T) decode_top(std::vector<T>& val, const Extend *ext) {
+        while (fetch()) {
+            val.push_back(T());
+            T& tmp = val.back();
+            X_PACK_INSTRUMENT_TYPE(DECODE, T)
+            tmp.__x_pack_decode(*this, tmp, ext);
+        }
+        return true;
+    }
+    template <class T>
+    inline XPACK_IS_XOUT(T) decode_top(T& val, const Extend *ext) {
+        if (fetch()) {
+            __x_pack_decode_out(*this, val, ext);
+            return true;
+        }
+        return false;
+    }
+    template <class T>
+    inline XPACK_IS_XOUT(T) decode_top(std::vector<T>& val, const Extend *ext) {
+        while (fetch()) {
+            val.push_back(T());
+            __x_pack_decode_out(*this, val.back(), ext);
+        }
+        return true;
+    }
+
+    const char *column(int idx) const {
+        return _fields[idx].name;
+    }
+    int find(const char*field) const {
+        std::map<const char*, int, cmp_str>::const_iterator it = _index.find(field);
+        if (it != _index.end()) {
+            return it->second;
+        }
+        return -1;
+    }
+
+    // std::string, same as the text protocol
+    bool decode_type(const int idx, std::string &val, const Extend *ext) {
+        (void)ext;
+        const Column &c = _cols[idx];
+        switch (_binds[idx].buffer_type) {
+        case MYSQL_TYPE_LONGLONG:
+            if (_binds[idx].is_unsigned) {
+                val = Util::itoa((uint64_t)c.i);
+            } else {
+                val = Util::itoa((int64_t)c.i);
+            }
+            break;
+        case MYSQL_TYPE_DOUBLE:
+            val = Util::dtoa(c.d);
+            break;
+        case MYSQL_TYPE_STRING:
+            val.assign(&c.str[0], c.length);
+            break;
+        default: {
+                char buf[64];
+                val.assign(buf, format(c.t, _binds[idx].buffer_type, _fields[idx].decimals, buf));
+            }
+        }
+        return true;
+    }
+    // bool
+    bool decode_type(const int idx, bool &val, const Extend *ext) {
+        int64_t tmp;
+        if (decode_type(idx, tmp, ext)) {
+            val = tmp != 0;
+            return true;
+        }
+        return false;
+    }
+    // integer. DATETIME/TIMESTAMP to unix timestamp(value is local time), TIME to seconds, DATE to year(same as MySQLDecoder)
+    template <class T>
+    typename x_enable_if<numeric<T>::is_integer, bool>::type decode_type(const int idx, T &val, const Extend *ext) {
+        (void)ext;
+        const Column &c = _cols[idx];
+        switch (_binds[idx].buffer_type) {
+        case MYSQL_TYPE_LONGLONG:
+            val = (T)c.i;
+            break;
+        case MYSQL_TYPE_DOUBLE:
+            val = (T)c.d;
+            break;
+        case MYSQL_TYPE_STRING:
+            if (Util::atoi(&c.str[0], c.length, val)) {
+                break;
+            } else if (numeric<T>::is_signed) { // not plain digits, such as DECIMAL 12.50
+                val = (T)strtoll(&c.str[0], NULL, 10);
+            } else {
+                val = (T)strtoull(&c.str[0], NULL, 10);
+            }
+            break;
+        case MYSQL_TYPE_TIME: {
+                int64_t sec = ((int64_t)c.t.day*24 + c.t.hour)*3600 + c.t.minute*60 + c.t.second;
+                val = (T)(c.t.neg ? -sec : sec);
+            }
+            break;
+        case MYSQL_TYPE_DATETIME:
+        case MYSQL_TYPE_TIMESTAMP:
+            if (c.t.month >= 1 && c.t.month <= 12 && c.t.day >= 1) {
+                int64_t local = Util::days_from_civil(c.t.year, c.t.month, c.t.day)*86400 + c.t.hour*3600 + c.t.minute*60 + c.t.second;
+                val = (T)_local.to_utc(local);
+            } else {
+                val = 0; // such as 0000-00-00 00:00:00
+            }
+            break;
+        default:
+            val = (T)c.t.year;
+        }
+        return true;
+    }
+    // float
+    template <class T>
+    typename x_enable_if<numeric<T>::is_float, bool>::type decode_type(const int idx, T &val, const Extend *ext) {
+        (void)ext;
+        const Column &c = _cols[idx];
+        switch (_binds[idx].buffer_type) {
+        case MYSQL_TYPE_DOUBLE:
+            val = (T)c.d;
+            break;
+        case MYSQL_TYPE_LONGLONG:
+            if (_binds[idx].is_unsigned) {
+                val = (T)(unsigned long long)c.i;
+            } else {
+                val = (T)c.i;
+            }
+            break;
+        case MYSQL_TYPE_STRING:
+            val = (T)std::strtod(&c.str[0], NULL);
+            break;
+        default:
+            val = 0;
+        }
+        return true;
+    }
+
+    // mysql covert type, column is passed as text
+    template <class T>
+    inline typename x_enable_if<is_xpack_mysql_xtype<T>::value, bool>::type decode_type(const int idx, T &val, const Extend *ext) {
+        std::string str;
+        decode_type(idx, str, ext);
+        return xpack_mysql_decode(&_fields[idx], (char*)str.c_str(), val, ext);
+    }
+
+    // class/struct defined XPACK/XPACK_OUT, default use json to parse, if use other, use xpack_mysql_decode
+    template <class T>
+    inline XPACK_IS_XOUT(T) decode_type(const int idx, T &val, const Extend *ext) {
+        std::string str;
+        decode_type(idx, str, ext);
+        xpack::json::decode(str, val);
+        return true;
+    }
+    template <class T>
+    inline XPACK_IS_XPACK(T) decode_type(const int idx, T &val, const Extend *ext) {
+        std::string str;
+        decode_type(idx, str, ext);
+        xpack::json::decode(str, val);
+        return true;
+    }
+
+    // MYSQL_TIME to text, same as the text protocol. return the length
+    static size_t format(const MYSQL_TIME &t, int type, unsigned int decimals, char *buf) {
+        int n;
+        if (MYSQL_TYPE_DATE == type) {
+            n = snprintf(buf, 64, "%04u-%02u-%02u", t.year, t.month, t.day);
+        } else if (MYSQL_TYPE_TIME == type) {
+            n = snprintf(buf, 64, "%s%02u:%02u:%02u", t.neg?"-":"", t.day*24+t.hour, t.minute, t.second);
+        } else {
+            n = snprintf(buf, 64, "%04u-%02u-%02u %02u:%02u:%02u", t.year, t.month, t.day, t.hour, t.minute, t.second);
+        }
+        if (MYSQL_TYPE_DATE != type && decimals > 0 && decimals <= 6) {
+            char frac[8];
+            snprintf(frac, sizeof(frac), "%06lu", (unsigned long)t.second_part);
+            buf[n++] = '.';
+            memcpy(buf+n, frac, decimals);
+            n += (int)decimals;
+        }
+        return (size_t)n;
+    }
+};
+
+}
+
+#endif
@@ -26,6 +26,7 @@
 #include <sqlite.h>
 
 #include "extend.h"
+#include "instrument.h"
 #include "traits.h"
 #include "json.h"
 
@@ -36,10 +37,11 @@ namespace xpack {
 
 class SQLiteDecoder {
     friend class sqlite;
+    friend class ColumnPlan;
 public:
     template <typename T>
     bool decode(const char*key, T&val, const Extend *ext) {
-        int idx = find(key);
+        int idx = _plan.get(key, *this);
         if (idx >= 0) {
             return this->decode_type(idx, val, ext);
         }
@@ -55,6 +57,7 @@ private:
     const int _cols;
     int _offset;
     std::map<const char*, int, cmp_str> _index;
+    ColumnPlan _plan;
 
     SQLiteDecoder(const char**result, int rows, int cols):_res(result), _rows(rows), _cols(cols) {
         for (int i=0; i<cols; ++i) {
@@ -67,6 +70,7 @@ private:
     template <class T>
     inline XPACK_IS_XPACK(T) decode_top(T& val, const Extend *ext) {
         if (_rows > 0) {
+            X_PACK_INSTRUMENT_TYPE(DECODE, T)
             val.__x_pack_decode(*this, val, ext);
             return true;
         }
@@ -77,6 +81,8 @@ private:
         for (int i=0; i<_rows; ++i) {
             val.push_back(T());
             T& tmp = val.back();
+            _plan.rewind();
+            X_PACK_INSTRUMENT_TYPE(DECODE, T)
             tmp.__x_pack_decode(*this, tmp, ext);
             _offset += _cols;
         }
@@ -93,6 +99,7 @@ private:
     inline XPACK_IS_XOUT(T) decode_top(std::vector<T>& val, const Extend *ext) {
         for (int i=0; i<_rows; ++i) {
             val.push_back(T());
+            _plan.rewind();
             __x_pack_decode_out(*this, val.back(), ext);
             _offset += _cols;
         }
@@ -125,6 +132,9 @@ private:
     }
 
 
+    const char *column(int idx) const {
+        return _res[idx];
+    }
     int find(const char*field) const {
         std::map<const char*, int, cmp_str>::const_iterator it = _index.find(field);
         if (it != _index.end()) {
@@ -155,7 +165,9 @@ private:
     typename x_enable_if<numeric<T>::is_integer, bool>::type decode_type(const int idx, T &val, const Extend *ext) {
         const char* s;
         if (NULL != (s = _res[idx + _offset])) {
-            val = (T)std::strtoul(s, NULL, 10);
+            if (!Util::atoi(s, val)) { // not plain digits, such as 12.5
+                val = (T)std::strtoul(s, NULL, 10);
+            }
         } // else val = 0 ???
         return true;
     }
@@ -0,0 +1,45 @@
+/*
+* Copyright (C) 2021 Duowan Inc. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef __X_PACK_SQLITE_STMT_H
+#define __X_PACK_SQLITE_STMT_H
+
+#include "sqlite_stmt_decoder.h"
+#include "xpack.h"
+
+namespace xpack {
+
+// stmt is prepared(sqlite3_prepare_v2) and bound by caller, it is not reset or finalized
+class sqlite_stmt {
+public:
+    // step stmt and convert rows to a struct(first row) or vector<struct>
+    template <class T>
+    static void decode(sqlite3_stmt *stmt, T &val) {
+        SQLiteStmtDecoder de(stmt);
+        de.decode_top(val, NULL);
+    }
+
+    // step stmt till the end and call f(T&) for each row, return the count
+    template <class T, class F>
+    static size_t for_each(sqlite3_stmt *stmt, F f) {
+        SQLiteStmtDecoder de(stmt);
+        return decode_each<T>(de, f);
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,194 @@
+/*
+* Copyright (C) 2021 Duowan Inc. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef __X_PACK_SQLITE_STMT_DECODER_H
+#define __X_PACK_SQLITE_STMT_DECODER_H
+
+#include <stdexcept>
+#include <vector>
+#include <map>
+#include <string>
+
+#include <sqlite3.h>
+
+#include "extend.h"
+#include "instrument.h"
+#include "traits.h"
+#include "json.h"
+
+namespace xpack {
+
+/*
+  decode rows of a sqlite3_stmt by sqlite3_step, one row at a time.
+  columns are read by the typed accessors(int64/double/text/blob), NULL column is skipped
+*/
+class SQLiteStmtDecoder:private noncopyable {
+    friend class sqlite_stmt;
+    friend class ColumnPlan;
+public:
+    template <typename T>
+    bool decode(const char*key, T&val, const Extend *ext) {
+        int idx = _plan.get(key, *this);
+        if (idx >= 0 && SQLITE_NULL != sqlite3_column_type(_stmt, idx)) {
+            return this->decode_type(idx, val, ext);
+        }
+        return false;
+    }
+    const char *Name() const { // mysql and sqlite use db
+        return "db";
+    }
+    // decode the next row to a struct, return false if no more row. for decode_each
+    template <class T>
+    bool next(T &val) {
+        return this->decode_top(val, NULL);
+    }
+
+private:
+    sqlite3_stmt *_stmt;
+    std::vector<std::string> _names; // copied, the names of stmt may change when it is reprepared by sqlite3_step
+    std::map<const char*, int, cmp_str> _index;
+    ColumnPlan _plan;
+
+    SQLiteStmtDecoder(sqlite3_stmt *stmt):_stmt(stmt) {
+        int cols = sqlite3_column_count(stmt);
+        _names.resize(cols);
+        for (int i=0; i<cols; ++i) {
+            const char *name = sqlite3_column_name(stmt, i);
+            _names[i] = (NULL != name) ? name : "";
+        }
+        for (int i=0; i<cols; ++i) {
+            _index[_names[i].c_str()] = i;
+        }
+    }
+
+    // step to next row, return false if done
+    bool step() {
+        int ret = sqlite3_step(_stmt);
+        if (SQLITE_ROW == ret) {
+            _plan.rewind();
+            return true;
+        } else if (SQLITE_DONE == ret) {
+            return false;
+        }
+        throw std::runtime_error(std::string("sqlite: ")+sqlite3_errmsg(sqlite3_db_handle(_stmt)));
+    }
+
+    // decode to struct
+    template <class T>
+    inline XPACK_IS_XPACK(T) decode_top(T& val, const Extend *ext) {
+        if (step()) {
+            X_PACK_INSTRUMENT_TYPE(DECODE, T)
+            val.__x_pack_decode(*this, val, ext);
+            return true;
+        }
+        return false;
+    }
+    template <class T>
+    inline XPACK_IS_XPACK(T) decode_top(std::vector<T>& val, const Extend *ext) {
+        while (step()) {
+            val.push_back(T());
+            T& tmp = val.back();
+            X_PACK_INSTRUMENT_TYPE(DECODE, T)
+            tmp.__x_pack_decode(*this, tmp, ext);
+        }
+        return true;
+    }
+    template <class T>
+    inline XPACK_IS_XOUT(T) decode_top(T& val, const Extend *ext) {
+        if (step()) {
+            __x_pack_decode_out(*this, val, ext);
+            return true;
+        }
+        return false;
+    }
+    template <class T>
+    inline XPACK_IS_XOUT(T) decode_top(std::vector<T>& val, const Extend *ext) {
+        while (step()) {
+            val.push_back(T());
+            __x_pack_decode_out(*this, val.back(), ext);
+        }
+        return true;
+    }
+
+    const char *column(int idx) const {
+        return _names[idx].c_str();
+    }
+    int find(const char*field) const {
+        std::map<const char*, int, cmp_str>::const_iterator it = _index.find(field);
+        if (it != _index.end()) {
+            return it->second;
+        }
+        return -1;
+    }
+
+    // std::string, blob is copied as is
+    bool decode_type(const int idx, std::string &val, const Extend *ext) {
+        (void)ext;
+        const char *data;
+        if (SQLITE_BLOB == sqlite3_column_type(_stmt, idx)) {
+            data = (const char*)sqlite3_column_blob(_stmt, idx);
+        } else {
+            data = (const char*)sqlite3_column_text(_stmt, idx);
+        }
+        int len = sqlite3_column_bytes(_stmt, idx); // after blob/text
+        if (NULL != data) {
+            val.assign(data, (size_t)len);
+        } else {
+            val.clear();
+        }
+        return true;
+    }
+    // bool
+    bool decode_type(const int idx, bool &val, const Extend *ext) {
+        (void)ext;
+        val = sqlite3_column_int64(_stmt, idx) != 0;
+        return true;
+    }
+    // integer
+    template <class T>
+    typename x_enable_if<numeric<T>::is_integer, bool>::type decode_type(const int idx, T &val, const Extend *ext) {
+        (void)ext;
+        val = (T)sqlite3_column_int64(_stmt, idx);
+        return true;
+    }
+    // float
+    template <class T>
+    typename x_enable_if<numeric<T>::is_float, bool>::type decode_type(const int idx, T &val, const Extend *ext) {
+        (void)ext;
+        val = (T)sqlite3_column_double(_stmt, idx);
+        return true;
+    }
+    // class/struct defined XPACK/XPACK_OUT, default use json to parse
+    template <class T>
+    inline XPACK_IS_XOUT(T) decode_type(const int idx, T &val, const Extend *ext) {
+        std::string str;
+        decode_type(idx, str, ext);
+        xpack::json::decode(str, val);
+        return true;
+    }
+    template <class T>
+    inline XPACK_IS_XPACK(T) decode_type(const int idx, T &val, const Extend *ext) {
+        std::string str;
+        decode_type(idx, str, ext);
+        xpack::json::decode(str, val);
+        return true;
+    }
+};
+
+
+}
+
+#endif
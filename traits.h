@@ -77,6 +77,23 @@ private:
     noncopyable& operator = (const noncopyable&v);
 };
 
+// name of the coder for alias, NULL if the coder does not implement Name()(such as a custom decoder)
+template <class C>
+struct x_has_name {
+    template <class U> static x_size<1> test(x_size<sizeof(&U::Name)>*);
+    template <class U> static x_size<2> test(...);
+    static bool const value = sizeof(test<C>(0)) == 1;
+};
+template <class C>
+inline typename x_enable_if<x_has_name<C>::value, const char*>::type x_coder_name(C &c) {
+    return c.Name();
+}
+template <class C>
+inline typename x_enable_if<!x_has_name<C>::value, const char*>::type x_coder_name(C &c) {
+    (void)c;
+    return NULL;
+}
+
 }
 
 #define x_pack_decltype(T) typename xpack::x_decltype_decode<sizeof(xpack::x_decltype_encode(T))>::type
@@ -23,8 +23,15 @@
 #include <stdexcept>
 #include <memory>
 
+#include <float.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+
+#include "rapidjson_custom.h"
+#include "rapidjson/internal/dtoa.h"
+#include "rapidjson/internal/itoa.h"
 
 #include "traits.h"
 #include "numeric.h"
@@ -89,29 +96,51 @@ public:
         return slice.size();
     }
 
+    // integer to decimal, write to buf(at least 21 bytes, no '\0'), return end of the output
+    template <class T>
+    static typename x_enable_if<numeric<T>::is_integer && numeric<T>::is_signed, char*>::type itoa(const T&val, char *buf) {
+        return rapidjson::internal::i64toa((int64_t)val, buf);
+    }
+    template <class T>
+    static typename x_enable_if<numeric<T>::is_integer && !numeric<T>::is_signed, char*>::type itoa(const T&val, char *buf) {
+        return rapidjson::internal::u64toa((uint64_t)val, buf);
+    }
     // not support float.
     template <class T>
     static typename x_enable_if<numeric<T>::is_integer, std::string>::type itoa(const T&val) {
-        #ifdef X_PACK_SUPPORT_CXX0X
-        return std::to_string(val);
-        #else
-        char buf[128];
-        size_t i = sizeof(buf)-1;
-
-        if (val == 0) {
-            return std::string("0");
-        }
+        char buf[32];
+        return std::string(buf, itoa(val, buf));
+    }
 
-        T _tmp = val>=0?val:val*-1;
-        while (_tmp > 0) {
-            buf[i--] = char(int('0')+int(_tmp%10));
-            _tmp /= 10;
+    /*
+    double to string, locale free and no allocation. write to buf(at least 32 bytes, no '\0'), return end of the output.
+    shortest string that round trip(Grisu2), or at most maxDecimalPlaces decimals(same as rapidjson Writer).
+    integral value has no ".0", nan/inf are written as nan/inf/-inf
+    */
+    static char* dtoa(double val, char *buf, int maxDecimalPlaces = 324) {
+        const char *sp = NULL;
+        if (val != val) {
+            sp = "nan";
+        } else if (val > DBL_MAX) {
+            sp = "inf";
+        } else if (val < -DBL_MAX) {
+            sp = "-inf";
+        }
+        if (NULL != sp) {
+            size_t len = strlen(sp);
+            memcpy(buf, sp, len);
+            return buf+len;
         }
-        if (val < 0) {
-            buf[i--] = '-';
+
+        char *end = rapidjson::internal::dtoa(val, buf, maxDecimalPlaces);
+        if (end-buf>2 && end[-2]=='.' && end[-1]=='0') {
+            end -= 2;
         }
-        return std::string(&buf[i+1], sizeof(buf)-i-1);
-        #endif
+        return end;
+    }
+    static std::string dtoa(double val, int maxDecimalPlaces = 324) {
+        char buf[64];
+        return std::string(buf, dtoa(val, buf, maxDecimalPlaces));
     }
 
     #ifdef X_PACK_SUPPORT_CXX0X
@@ -132,21 +161,21 @@ public:
 
     // not support float. and only decimal
     template <class T>
-    static typename x_enable_if<numeric<T>::is_integer, bool>::type atoi(const std::string&s, T&val) {
-        if (s.empty()) {
+    static typename x_enable_if<numeric<T>::is_integer, bool>::type atoi(const char*s, size_t len, T&val) {
+        if (len == 0) {
             return false;
         }
 
         T _tmp = 0;
         size_t i = 0;
         if (s[0] == '-') {
-            if (s.length() == 1) {
+            if (len == 1) {
                 return false;
-            } else if (s.length()>2 && s[1]=='0') {
+            } else if (len>2 && s[1]=='0') {
                 return false;
             }
 
-            for (i=1; i<s.length(); ++i) {
+            for (i=1; i<len; ++i) {
                 if (s[i]>='0' && s[i]<='9') {
                     T _c = _tmp*10 - (s[i]-'0');
                     if (_c < _tmp) {
@@ -160,12 +189,15 @@ public:
             }
         } else {
             if (s[0] == '+') {
+                if (len == 1) {
+                    return false;
+                }
                 ++i;
             }
-            if (s[i]=='0' && i+1<s.length()) {
+            if (s[i]=='0' && i+1<len) {
                 return false;
             }
-            for (; i<s.length(); ++i) {
+            for (; i<len; ++i) {
                 if (s[i]>='0' && s[i]<='9') {
                     T _c = _tmp*10 + (s[i]-'0');
                     if (_c > _tmp) {
@@ -183,13 +215,249 @@ public:
         return true;
     }
     template <class T>
+    static typename x_enable_if<numeric<T>::is_integer, bool>::type atoi(const std::string&s, T&val) {
+        return atoi(s.data(), s.length(), val);
+    }
+    template <class T>
     static typename x_enable_if<numeric<T>::is_integer, bool>::type atoi(const char*s, T&val) {
         if (NULL == s) {
             return false;
         }
-        std::string _t(s);
-        return atoi(_t, val);
+        return atoi(s, strlen(s), val);
+    }
+
+    // ~~~~~~~~~~~~~~~~~~~~~~~ date time ~~~~~~~~~~~~~~~~~~~~~~~
+    // parse/format use no libc time function, so they are thread safe and allocation free.
+    // days_from_civil/civil_from_days are from http://howardhinnant.github.io/date_algorithms.html
+
+    // days since 1970-01-01 of proleptic gregorian date y-m-d
+    static int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+        y -= (m <= 2);
+        const int64_t era = (y >= 0 ? y : y-399) / 400;
+        const unsigned yoe = (unsigned)(y - era*400);
+        const unsigned doy = (153*(m > 2 ? m-3 : m+9) + 2)/5 + d-1;
+        const unsigned doe = yoe*365 + yoe/4 - yoe/100 + doy;
+        return era*146097 + (int64_t)doe - 719468;
+    }
+    static void civil_from_days(int64_t z, int64_t &y, unsigned &m, unsigned &d) {
+        z += 719468;
+        const int64_t era = (z >= 0 ? z : z-146096) / 146097;
+        const unsigned doe = (unsigned)(z - era*146097);
+        const unsigned yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+        const unsigned doy = doe - (365*yoe + yoe/4 - yoe/100);
+        const unsigned mp = (5*doy + 2)/153;
+        d = doy - (153*mp + 2)/5 + 1;
+        m = mp < 10 ? mp+3 : mp-9;
+        y = (int64_t)yoe + era*400 + (m <= 2);
+    }
+
+    /*
+      parse "YYYY-MM-DD[T| ]HH:MM:SS[.fraction][Z|+hh:mm|-hh:mm]", the whole [s, s+len) must match.
+      sec is seconds since epoch, usec is the fraction in microseconds(further digits are dropped).
+      zone is false if no zone designator, then the fields are taken as UTC(see LocalTime)
+    */
+    static bool parse_datetime(const char *s, size_t len, int64_t &sec, int &usec, bool &zone) {
+        static const unsigned char mdays[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        const char *end = s+len;
+        int y, mon, d, h, min, sc;
+        if (len < 19 || !digits(s, 4, y) || s[4]!='-' || !digits(s+5, 2, mon) || s[7]!='-' || !digits(s+8, 2, d)
+            || (s[10]!='T' && s[10]!='t' && s[10]!=' ')
+            || !digits(s+11, 2, h) || s[13]!=':' || !digits(s+14, 2, min) || s[16]!=':' || !digits(s+17, 2, sc)) {
+            return false;
+        }
+        if (mon < 1 || mon > 12 || d < 1 || d > mdays[mon-1] || h > 23 || min > 59 || sc > 60) { // 60 is leap second
+            return false;
+        } else if (mon == 2 && d == 29 && !(y%4 == 0 && (y%100 != 0 || y%400 == 0))) {
+            return false;
+        }
+
+        s += 19;
+        usec = 0;
+        if (s < end && *s == '.') {
+            const char *f = ++s;
+            for (int scale = 100000; s < end && *s >= '0' && *s <= '9'; ++s, scale /= 10) {
+                usec += (*s-'0')*scale;
+            }
+            if (s == f) {
+                return false;
+            }
+        }
+
+        int offset = 0;
+        zone = (s < end);
+        if (s+1 == end && (*s == 'Z' || *s == 'z')) {
+            s = end;
+        } else if (s+6 == end && (*s == '+' || *s == '-') && s[3] == ':') {
+            int oh, om;
+            if (!digits(s+1, 2, oh) || !digits(s+4, 2, om) || oh > 23 || om > 59) {
+                return false;
+            }
+            offset = (*s == '+' ? 1 : -1) * (oh*3600 + om*60);
+            s = end;
+        }
+        if (s != end) {
+            return false;
+        }
+
+        sec = days_from_civil(y, (unsigned)mon, (unsigned)d)*86400 + h*3600 + min*60 + sc - offset;
+        return true;
     }
+
+    // write "YYYY-MM-DDTHH:MM:SS[.mmm]Z" of milliseconds since epoch to buf(32 bytes at least), .mmm is omitted if 0.
+    // return the length, buf is null terminated
+    static size_t format_datetime(int64_t msec, char *buf) {
+        int64_t sec = (msec >= 0) ? msec/1000 : -((-msec+999)/1000);
+        int ms = (int)(msec - sec*1000);
+        int64_t days = (sec >= 0) ? sec/86400 : -((-sec+86399)/86400);
+        int secs = (int)(sec - days*86400);
+        int64_t y;
+        unsigned m, d;
+        civil_from_days(days, y, m, d);
+
+        char *p = buf;
+        if (y < 0) {
+            *p++ = '-';
+            y = -y;
+        }
+        char tmp[24];
+        int n = 0;
+        do {
+            tmp[n++] = (char)('0' + y%10);
+            y /= 10;
+        } while (y > 0 || n < 4);
+        while (n > 0) {
+            *p++ = tmp[--n];
+        }
+        *p++ = '-';
+        p = two(p, (int)m);
+        *p++ = '-';
+        p = two(p, (int)d);
+        *p++ = 'T';
+        p = two(p, secs/3600);
+        *p++ = ':';
+        p = two(p, secs/60%60);
+        *p++ = ':';
+        p = two(p, secs%60);
+        if (ms > 0) {
+            *p++ = '.';
+            *p++ = (char)('0' + ms/100);
+            p = two(p, ms%100);
+        }
+        *p++ = 'Z';
+        *p = '\0';
+        return p-buf;
+    }
+
+    // offset of local time to UTC at t(seconds since epoch), e.g. 28800 for UTC+8
+    static int local_offset(int64_t t) {
+        time_t tt = (time_t)t;
+        struct tm tm;
+    #ifdef _MSC_VER
+        if (0 != localtime_s(&tm, &tt)) {
+            return 0;
+        }
+    #else
+        if (NULL == localtime_r(&tt, &tm)) {
+            return 0;
+        }
+    #endif
+        int64_t local = days_from_civil(tm.tm_year+1900, (unsigned)tm.tm_mon+1, (unsigned)tm.tm_mday)*86400 + tm.tm_hour*3600 + tm.tm_min*60 + tm.tm_sec;
+        return (int)(local - t);
+    }
+
+private:
+    static bool digits(const char *s, int n, int &val) {
+        val = 0;
+        for (int i=0; i<n; ++i) {
+            if (s[i] < '0' || s[i] > '9') {
+                return false;
+            }
+            val = val*10 + (s[i]-'0');
+        }
+        return true;
+    }
+    static char* two(char *p, int v) {
+        p[0] = (char)('0' + v/10);
+        p[1] = (char)('0' + v%10);
+        return p+2;
+    }
+};
+
+/*
+  local time to UTC, same as mktime(tm_isdst = -1) but the offset of each day is cached,
+  so localtime is called only when the day changes. not thread safe, use one per decoder.
+*/
+class LocalTime {
+public:
+    LocalTime():_day(0), _offset(0), _valid(false) {
+    }
+    // local is the fields of local time taken as UTC, such as sec of Util::parse_datetime without zone
+    int64_t to_utc(int64_t local) {
+        int64_t day = (local >= 0) ? local/86400 : -((-local+86399)/86400);
+        if (!_valid || day != _day) {
+            int begin = offset(day*86400);
+            int end = offset(day*86400+86399);
+            _day = day;
+            _offset = begin;
+            _valid = (begin == end); // no daylight saving transition in this day
+            if (!_valid) {
+                return local - offset(local);
+            }
+        }
+        return local - _offset;
+    }
+private:
+    static int offset(int64_t local) {
+        int o = Util::local_offset(local);
+        return Util::local_offset(local - o);
+    }
+    int64_t _day;
+    int _offset;
+    bool _valid;
+};
+
+
+/*
+  column of each field for the db decoders. a struct decodes its fields in the same order for every row,
+  so the columns are found for the first row and replayed by position for the rest.
+  keys are matched by address(string literal or static alias of XPACK) and checked against the column name.
+*/
+class ColumnPlan {
+public:
+    ColumnPlan():_pos(0) {
+    }
+    // call at the start of each row
+    void rewind() {
+        _pos = 0;
+    }
+    /*
+      column of key, -1 if not found. de.column(idx) is the column name, de.find(key) is called if
+      key is not planned, or planned as not found, so a plan is never wrong for another result set
+    */
+    template <class Decoder>
+    int get(const char *key, const Decoder &de) {
+        if (_pos < _steps.size()) {
+            const Step &s = _steps[_pos];
+            if (s.key == key && ((s.idx < 0) ? (de.find(key) < 0) : (0 == strcmp(de.column(s.idx), key)))) {
+                ++_pos;
+                return s.idx;
+            }
+            _steps.resize(_pos); // order changed, plan again from here
+        }
+        Step s;
+        s.key = key;
+        s.idx = de.find(key);
+        _steps.push_back(s);
+        ++_pos;
+        return s.idx;
+    }
+private:
+    struct Step {
+        const char *key;
+        int idx;
+    };
+    std::vector<Step> _steps;
+    size_t _pos;
 };
 
 
@@ -25,6 +25,7 @@
 #include <list>
 
 #include "extend.h"
+#include "instrument.h"
 #include "traits.h"
 
 #include "string.h"
@@ -66,9 +67,9 @@ class XDecoder {
 public:
     typedef XDecoder<Node> decoder;
 
-    XDecoder(const decoder* parent, const char* key, Node node):_p(parent),_k(key),_i(-1),_n(node) {}
-    XDecoder(const decoder *parent, int index, Node node):_p(parent),_k(NULL),_i(index),_n(node) {}
-    XDecoder():_i(-2){}
+    XDecoder(const decoder* parent, const char* key, Node node):_p(parent),_k(key),_i(-1),_n(node),_patch(NULL!=parent && parent->_patch) {}
+    XDecoder(const decoder *parent, int index, Node node):_p(parent),_k(NULL),_i(index),_n(node),_patch(NULL!=parent && parent->_patch) {}
+    XDecoder():_i(-2),_patch(false){}
 
     const char *Name() const {
         return Node::Name();
@@ -98,7 +99,7 @@ public:
         Node child = _n.Find(*this, key, ext);
         if (child){
             return XDecoder(this, key, child);
-        } else if (Extend::Mandatory(ext)) {
+        } else if (Extend::Mandatory(ext) && !_patch) { // patch only contains the members to be changed
             decode_exception("mandatory key not found", key);
         }
 
@@ -113,6 +114,10 @@ public:
     bool decode(const char*key, T&val, const Extend*ext) {
         decoder child = Find(key, ext);
         if (child) {
+            if (_patch && child._n.IsNull()) {
+                reset(val);
+                return true;
+            }
             return child.decode_type(val, ext);
         }
         return false;
@@ -123,14 +128,32 @@ public:
         return this->decode_type(val, ext);
     }
 
+    /*
+    apply node as a merge patch(RFC 7396) to val:
+    - only members present in node are changed, others keep untouched
+    - null resets the member to default value, and removes the key of map
+    - struct/map/shared_ptr are patched recursively, other containers are replaced
+    */
+    template <class T>
+    bool patch(T &val, const Extend*ext) {
+        _patch = true;
+        if (_n.IsNull()) {
+            reset(val);
+            return true;
+        }
+        return this->decode_type(val, ext);
+    }
+
     // class/struct that defined macro XPACK, !is_xpack_out to avoid inherit __x_pack_value
     template <class T>
     inline typename x_enable_if<T::__x_pack_value && !is_xpack_out<T>::value, bool>::type decode_struct(T& val, const Extend *ext) {
+        X_PACK_INSTRUMENT_TYPE(DECODE, T)
         return val.__x_pack_decode(*this, val, ext);
     }
     // class/struct that defined macro XPACK_OUT
     template <class T>
     inline typename x_enable_if<is_xpack_out<T>::value, bool>::type decode_struct(T& val, const Extend *ext) {
+        X_PACK_INSTRUMENT_TYPE(DECODE, T)
         return __x_pack_decode_out(*this, val, ext);
     }
 
@@ -138,6 +161,10 @@ public:
     inline bool decode_struct(const char*key, T&val, const Extend *ext) {
         decoder child = Find(key, ext);
         if (child) {
+            if (_patch && child._n.IsNull()) {
+                reset(val);
+                return true;
+            }
             return child.decode_struct(val, ext);
         }
         return false;
@@ -208,6 +235,9 @@ private:
     bool decode_type(std::shared_ptr<T>& val, const Extend *ext) {
         bool ret = false;
         if (!_n.IsNull()) {
+            if (_patch && val.get() != NULL) { // patch the existing object
+                return this->decode_type(*val, ext);
+            }
             val.reset(new T);
             ret = this->decode_type(*val, ext);
             if (!ret) {
@@ -271,6 +301,11 @@ private:
     ///////////////////////////////////////////////////
     template <class T>
     bool decode_array(T *val, size_t N, const Extend *ext) {
+        if (_patch) {
+            for (size_t i=0; i<N; ++i) {
+                reset(val[i]);
+            }
+        }
         size_t mx = _n.Size(*this);
         mx = mx>N?N:mx;
 
@@ -294,6 +329,9 @@ private:
     template <class Vector>
     bool decode_vector(Vector &val, const Extend *ext) {
         size_t s = _n.Size(*this);
+        if (_patch) {
+            val.clear();
+        }
         val.resize(s);
         for (size_t i=0; i<s; ++i) {
             this->at(i, ext).decode_type(val[i], ext);
@@ -304,6 +342,9 @@ private:
     template <class List, class Elem>
     bool decode_list(List &val, const Extend *ext) {
         size_t s = _n.Size(*this);
+        if (_patch) {
+            val.clear();
+        }
         for (size_t i=0; i<s; ++i) {
             Elem _t;
             this->at(i, ext).decode_type(_t, ext);
@@ -319,9 +360,17 @@ private:
         Node tmp = _n.Next(*this, _n, iter, key);
         while (tmp) {
             K k;
-            V v;
-            if (keyConvert(key, k) && XDecoder(this, key.c_str(), tmp).decode_type(v, ext)) {
-                val[k] = v;
+            if (!_patch) {
+                V v;
+                if (keyConvert(key, k) && XDecoder(this, key.c_str(), tmp).decode_type(v, ext)) {
+                    val[k] = v;
+                }
+            } else if (keyConvert(key, k)) { // patch: null remove the key, others patch the value in place
+                if (tmp.IsNull()) {
+                    this->del_ele(val, k);
+                } else {
+                    XDecoder(this, key.c_str(), tmp).decode_type(val[k], ext);
+                }
             }
             tmp = tmp.Next(*this, _n, iter, key);
         }
@@ -344,6 +393,28 @@ private:
         val.push_back(t);
     }
     #endif
+    template <class Map, class K>
+    inline void del_ele(Map&val, const K&k) {
+        val.erase(k);
+    }
+    #ifdef XPACK_SUPPORT_QT
+    template <class K, class V>
+    inline void del_ele(QMap<K, V>&val, const K&k) {
+        val.remove(k);
+    }
+    #endif
+
+    // reset to default value, for patch
+    template <class T>
+    static void reset(T &val) {
+        val = T();
+    }
+    template <class T, size_t N>
+    static void reset(T (&val)[N]) {
+        for (size_t i=0; i<N; ++i) {
+            reset(val[i]);
+        }
+    }
 
     // convert map key
     inline bool keyConvert(std::string&s, std::string&key) {
@@ -409,8 +480,29 @@ private:
     const char* _k;
     int _i;
     Node _n;
+    bool _patch; // apply as merge patch, inherit from parent
 };
 
+/*
+  decode the records of rd one by one and call f(T&) for each, return the count.
+  Reader need implement: template<class T> bool next(T&val), false if no more record.
+  val is reset to T() between records so a field absent in this record is not left
+  from the previous one. it is copy assigned from one default T instead of a temporary,
+  so strings and containers of val are cleared but keep their capacity for the next record.
+*/
+template <class T, class Reader, class F>
+size_t decode_each(Reader &rd, F f) {
+    size_t num = 0;
+    const T def = T();
+    T val = def;
+    while (rd.next(val)) {
+        f(val);
+        ++num;
+        val = def;
+    }
+    return num;
+}
+
 }
 
 #endif
@@ -24,6 +24,7 @@
 #include <list>
 
 #include "extend.h"
+#include "instrument.h"
 #include "traits.h"
 #include "numeric.h"
 
@@ -230,6 +231,7 @@ public:
         if (!inherit) {
             _w.ObjectBegin(key, ext);
         }
+        X_PACK_INSTRUMENT_TYPE(ENCODE, T)
         bool ret = val.__x_pack_encode(*this, val, ext);
         if (!inherit) {
             _w.ObjectEnd(key, ext);
@@ -244,6 +246,7 @@ public:
         if (!inherit) {
            _w.ObjectBegin(key, ext);
         }
+        X_PACK_INSTRUMENT_TYPE(ENCODE, T)
         bool ret = __x_pack_encode_out(*this, val, ext);
         if (!inherit) {
             _w.ObjectEnd(key, ext);
@@ -19,6 +19,7 @@
 
 #include "xml_decoder.h"
 #include "xml_encoder.h"
+#include "xml_reader.h"
 #include "xpack.h"
 
 namespace xpack {
@@ -52,25 +53,50 @@ class xml {
 public:
     template <class T>
     static void decode(const std::string &data, T &val) {
+        X_PACK_INSTRUMENT_BYTES(DECODE, T, data.size())
         XmlDecoder de;
         de.decode(data, val);
     }
+    // data must be null terminated, it is read in place without copy
+    template <class T>
+    static void decode(const char *data, T &val) {
+        X_PACK_INSTRUMENT_BYTES(DECODE, T, strlen(data))
+        XmlDecoder de;
+        de.decode(data, val);
+    }
+    // parse the null terminated data in place, data is modified
+    template <class T>
+    static void decode_inplace(char *data, T &val) {
+        X_PACK_INSTRUMENT_BYTES(DECODE, T, strlen(data))
+        XmlDecoder de;
+        de.decode_inplace(data, val);
+    }
     template <class T>
     static void decode_file(const std::string &file_name, T &val) {
         XmlDecoder de;
         de.decode_file(file_name, val);
     }
+    // decode the record elements of a huge document one by one and call f(T&) for each, return the count
+    template <class T, class F>
+    static size_t for_each(std::istream &is, const std::string &record, F f) {
+        XmlReader reader(is, record);
+        return decode_each<T>(reader, f);
+    }
     template <class T>
     static std::string encode(const T &val, const std::string&root) {
         XmlEncoder en;
-        return en.encode(val, root);
+        std::string s = en.encode(val, root);
+        X_PACK_INSTRUMENT_BYTES(ENCODE, T, s.size())
+        return s;
     }
 
     template <class T>
     static std::string encode(const T &val, const std::string&root, int flag, int indentCount, char indentChar) {
         (void)flag;
         XmlEncoder en(indentCount, indentChar);
-        return en.encode(val, root);
+        std::string s = en.encode(val, root);
+        X_PACK_INSTRUMENT_BYTES(ENCODE, T, s.size())
+        return s;
     }
 };
 
@@ -27,6 +27,12 @@
 #include "rapidxml/rapidxml.hpp"
 
 #include "xdecoder.h"
+#include "xml_escape.h"
+
+// build hash index for the children lookup if the number of children reach it
+#ifndef X_PACK_XML_INDEX_THRESHOLD
+#define X_PACK_XML_INDEX_THRESHOLD 16
+#endif
 
 namespace xpack {
 
@@ -37,7 +43,8 @@ public:
     typedef size_t Iterator;
 
 public:
-    XmlNode(Node *n=NULL):node(n), attr(NULL), inited(false) {}
+    // raw: parsed with rapidxml::parse_non_destructive, values are neither null terminated nor unescaped
+    XmlNode(Node *n=NULL, bool _raw=false):node(n), attr(NULL), raw(_raw), inited(false), _cursor(NULL), _num(-1), _dup(false) {}
 
     inline static const char * Name() {
         return "xml";
@@ -50,25 +57,19 @@ public:
     }
     XmlNode Find(decoder&de, const char*key, const Extend *ext) {
         (void)de;
-        if (!inited) {
-            this->init();
-        }
         if (Extend::XmlContent(ext)) {
             return *this;
         }
 
-        node_index::iterator iter;
-        if (_childs_index.end() != (iter=_childs_index.find(key))) {
-            bool sbs = Extend::AliasFlag(ext, "xml", "sbs");
-            if (!sbs) {
-                return XmlNode(_childs[iter->second]);
-            } else {
-                XmlNode node(_childs[iter->second]);
-                node.initsbs(*this, key);
-                return node;
+        Node *child = this->find_child(key);
+        if (NULL != child) {
+            XmlNode tmp(child, raw);
+            if (Extend::AliasFlag(ext, "xml", "sbs")) {
+                tmp.initsbs(*this, key);
             }
+            return tmp;
         } else { // sbs not support attribute
-            XmlNode tmp;
+            XmlNode tmp(NULL, raw);
             tmp.attr = node->first_attribute(key);
             if (NULL != tmp.attr) {
                 tmp.node = this->node;
@@ -84,7 +85,7 @@ public:
         return _childs.size();
     }
     XmlNode At(size_t index) const { // no exception
-        return XmlNode(_childs[index]);
+        return XmlNode(_childs[index], raw);
     }
     // if child node defined sbs, results can be confusing
     XmlNode Next(decoder&de, XmlNode&p, Iterator&iter, std::string&key) {
@@ -100,35 +101,39 @@ public:
             }
 
             if (iter < p._childs.size()) {
-                key = p._childs[iter]->name();
-                return XmlNode(p._childs[iter]);
+                key.assign(p._childs[iter]->name(), p._childs[iter]->name_size());
+                return XmlNode(p._childs[iter], raw);
             }
         }
         return XmlNode();
     }
     bool Get(decoder&de, std::string&val, const Extend*ext) {
         if (!Extend::AliasFlag(ext, "xml", "cdata")) {
-            val = get_val(Extend::XmlContent(ext));
+            const char *v;
+            size_t len;
+            get_val(v, len, Extend::XmlContent(ext));
+            assign(val, v, len, true);
         } else {
             const Node *tmp = node->first_node();
             if (NULL != tmp) {
                 if (tmp->type() == rapidxml::node_cdata || tmp->type() == rapidxml::node_data) {
-                    val = tmp->value();
+                    assign(val, tmp->value(), tmp->value_size(), tmp->type() == rapidxml::node_data);
                 } else {
                     de.decode_exception("not cdata type", NULL);
                 }
             } else { // if node contain text not CDATA, get it
-                val = node->value();
+                assign(val, node->value(), node->value_size(), true);
             }
         }
         return true;
     }
     bool Get(decoder&de, bool &val, const Extend*ext) {
-        (void)ext;
-        std::string v = get_val(Extend::XmlContent(ext));
-        if (v=="1" || v=="true" || v=="TRUE" || v=="True") {
+        const char *v;
+        size_t len;
+        get_val(v, len, Extend::XmlContent(ext));
+        if (same(v, len, "1") || same(v, len, "true") || same(v, len, "TRUE") || same(v, len, "True")) {
             val = true;
-        } else if (v=="0" || v=="false" || v=="FALSE" || v=="False") {
+        } else if (same(v, len, "0") || same(v, len, "false") || same(v, len, "FALSE") || same(v, len, "False")) {
             val = false;
         } else {
             de.decode_exception("parse bool fail.", NULL);
@@ -137,9 +142,10 @@ public:
     }
     template <class T>
     typename x_enable_if<numeric<T>::is_integer, bool>::type Get(decoder&de, T &val, const Extend*ext){
-        (void)ext;
-        std::string v = get_val(Extend::XmlContent(ext));
-        if (Util::atoi(v, val)) {
+        const char *v;
+        size_t len;
+        get_val(v, len, Extend::XmlContent(ext));
+        if (Util::atoi(v, len, val)) {
             return true;
         } else {
             de.decode_exception("parse int fail. not integer or overflow", NULL);
@@ -148,16 +154,28 @@ public:
     }
     template <class T>
     typename x_enable_if<numeric<T>::is_float, bool>::type Get(decoder&de, T &val, const Extend*ext){
-        (void)ext;
-        std::string v = get_val(Extend::XmlContent(ext));
-        if (1==v.length() && v[0]=='-') {
+        const char *v;
+        size_t len;
+        get_val(v, len, Extend::XmlContent(ext));
+        if (1==len && v[0]=='-') {
             return false;
         }
 
-        const char *data = v.c_str();
+        // value may be not null terminated
+        char buf[64];
+        std::string big;
+        const char *data = buf;
+        if (len < sizeof(buf)) {
+            memcpy(buf, v, len);
+            buf[len] = '\0';
+        } else {
+            big.assign(v, len);
+            data = big.c_str();
+        }
+
         char *end;
         double d = strtod(data, &end);
-        if ((size_t)(end-data) == v.length()) {
+        if ((size_t)(end-data) == len) {
             val = (T)d;
             return true;
         }
@@ -166,43 +184,218 @@ public:
     }
 
 private:
-    typedef std::map<const char*, size_t, cmp_str> node_index; // index of _childs
+    struct Slot { // slot of the hash index
+        size_t hash;
+        Node *node;
+        Slot():hash(0), node(NULL){}
+    };
+    struct Group { // children with the same name, _grouped[off, off+num)
+        size_t hash;
+        const Node *first;
+        size_t off;
+        size_t num;
+        Group():hash(0), first(NULL), off(0), num(0){}
+    };
 
+    // only Size/At/Next need it
     void init() {
         inited = true;
         if (NULL != node) {
-            Node *tmp = node->first_node();
-            for (size_t i=0; tmp; tmp=tmp->next_sibling(), ++i) {
+            for (Node *tmp = node->first_node(); tmp; tmp=tmp->next_sibling()) {
                 _childs.push_back(tmp);
-                _childs_index[tmp->name()] = i;
             }
         }
     }
-    void initsbs(const XmlNode&parent, const char *key) {
+    void initsbs(XmlNode&parent, const char *key) {
         inited = true;
-        for (size_t i=0; i<parent._childs.size(); ++i) {
-            if (0 == strcmp(key, parent._childs[i]->name())) {
-                _childs.push_back(parent._childs[i]);
+        if (parent._groups.empty()) {
+            parent.build_groups();
+        }
+
+        size_t len = strlen(key);
+        size_t mask = parent._groups.size()-1;
+        size_t h = hash(key, len);
+        for (size_t i=h&mask; NULL!=parent._groups[i].first; i=(i+1)&mask) {
+            const Group &g = parent._groups[i];
+            if (g.hash == h && same_name(g.first, key, len)) {
+                _childs.assign(parent._grouped.begin()+g.off, parent._grouped.begin()+g.off+g.num);
+                break;
             }
         }
     }
+    // bucket the children by name in one pass, all the sbs members of a struct share it
+    void build_groups() {
+        std::vector<size_t> slots(_num); // group slot of each child, _num is counted by find_child
+
+        size_t cap = 2;
+        while (cap < _num*2) {
+            cap <<= 1;
+        }
+        _groups.resize(cap);
 
-    std::string get_val(bool forceContent=false) {
+        size_t mask = cap-1;
+        size_t n = 0;
+        for (Node *tmp = node->first_node(); tmp; tmp=tmp->next_sibling(), ++n) {
+            size_t h = hash(tmp->name(), tmp->name_size());
+            size_t i = h&mask;
+            for (; NULL!=_groups[i].first; i=(i+1)&mask) {
+                if (_groups[i].hash == h && same_name(_groups[i].first, tmp->name(), tmp->name_size())) {
+                    break;
+                }
+            }
+            if (NULL == _groups[i].first) {
+                _groups[i].hash = h;
+                _groups[i].first = tmp;
+            }
+            ++_groups[i].num;
+            slots[n] = i;
+        }
+
+        size_t off = 0;
+        for (size_t i=0; i<cap; ++i) {
+            _groups[i].off = off;
+            off += _groups[i].num;
+            _groups[i].num = 0;
+        }
+
+        _grouped.resize(slots.size());
+        n = 0;
+        for (Node *tmp = node->first_node(); tmp; tmp=tmp->next_sibling(), ++n) {
+            Group &g = _groups[slots[n]];
+            _grouped[g.off+g.num++] = tmp;
+        }
+    }
+
+    /*
+      members are usually declared in the same order as the document, so scan from the one after
+      the last hit and the key is found in the first try. if there are many children, build a hash
+      index at the first lookup instead. if names are duplicated, the first one wins in both ways,
+      so the cursor is not used then.
+    */
+    Node* find_child(const char *key) {
+        if (NULL == node) {
+            return NULL;
+        }
+
+        size_t len = strlen(key);
+        if (_num == (size_t)-1) {
+            _num = 0;
+            for (Node *tmp = node->first_node(); tmp; tmp=tmp->next_sibling()) {
+                ++_num;
+            }
+            if (_num >= X_PACK_XML_INDEX_THRESHOLD) {
+                this->build_index();
+            } else {
+                _dup = this->duplicated();
+            }
+        }
+
+        if (!_index.empty()) {
+            size_t mask = _index.size()-1;
+            size_t h = hash(key, len);
+            for (size_t i=h&mask; NULL!=_index[i].node; i=(i+1)&mask) {
+                if (_index[i].hash == h && same_name(_index[i].node, key, len)) {
+                    return _index[i].node;
+                }
+            }
+            return NULL;
+        }
+
+        Node *first = node->first_node();
+        Node *start = (!_dup && NULL!=_cursor && NULL!=_cursor->next_sibling()) ? _cursor->next_sibling() : first;
+        for (Node *tmp = start; NULL != tmp;) {
+            if (same_name(tmp, key, len)) {
+                _cursor = tmp;
+                return tmp;
+            }
+            tmp = tmp->next_sibling();
+            if (NULL == tmp) {
+                tmp = first;
+            }
+            if (tmp == start) {
+                break;
+            }
+        }
+        return NULL;
+    }
+    bool duplicated() const { // only for a few children
+        for (Node *a = node->first_node(); a; a=a->next_sibling()) {
+            for (Node *b = a->next_sibling(); b; b=b->next_sibling()) {
+                if (same_name(b, a->name(), a->name_size())) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+    void build_index() {
+        size_t cap = 2;
+        while (cap < _num*2) {
+            cap <<= 1;
+        }
+        _index.resize(cap);
+
+        size_t mask = cap-1;
+        for (Node *tmp = node->first_node(); tmp; tmp=tmp->next_sibling()) {
+            size_t h = hash(tmp->name(), tmp->name_size());
+            size_t i = h&mask;
+            for (; NULL!=_index[i].node; i=(i+1)&mask) {
+                if (_index[i].hash == h && same_name(_index[i].node, tmp->name(), tmp->name_size())) {
+                    break;
+                }
+            }
+            if (NULL == _index[i].node) {
+                _index[i].hash = h;
+                _index[i].node = tmp;
+            }
+        }
+    }
+    static bool same_name(const Node *n, const char *key, size_t len) {
+        return n->name_size() == len && 0 == memcmp(n->name(), key, len);
+    }
+    static size_t hash(const char *s, size_t len) { // FNV-1a
+        size_t h = 2166136261U;
+        for (size_t i=0; i<len; ++i) {
+            h = (h^(unsigned char)s[i])*16777619U;
+        }
+        return h;
+    }
+
+    void get_val(const char *&val, size_t &len, bool forceContent=false) const {
         if (forceContent || attr==NULL) {
-            return node->value();
-        } else if  (attr != NULL) {
-            return attr->value();
+            val = node->value();
+            len = node->value_size();
+        } else {
+            val = attr->value();
+            len = attr->value_size();
+        }
+    }
+    static bool same(const char *v, size_t len, const char *s) {
+        return len == strlen(s) && 0 == memcmp(v, s, len);
+    }
+    // text of the raw document need unescape
+    void assign(std::string &val, const char *v, size_t len, bool text) const {
+        if (!raw || !text || NULL == memchr(v, '&', len)) {
+            val.assign(v, len);
         } else {
-            return "";
+            val.clear();
+            val.reserve(len);
+            XmlEscape::unescape(val, v, len);
         }
     }
 
     const Node* node;   // current node
     rapidxml::xml_attribute<char> *attr;
-    bool inited;        // delay init to avoid copy _childs and _childs_index
+    bool raw;           // see constructor
+    bool inited;        // delay init to avoid copy _childs
 
-    std::vector<Node*> _childs;  // childs
-    node_index _childs_index;
+    std::vector<Node*> _childs;  // childs, for Size/At/Next
+    Node *_cursor;      // last hit of find_child
+    size_t _num;        // number of children, -1 means not counted yet
+    bool _dup;          // some children have the same name, find_child scans from the first one
+    std::vector<Slot> _index;    // hash index of children, empty if less than X_PACK_XML_INDEX_THRESHOLD
+    std::vector<Group> _groups;  // hash table of children grouped by name, built by the first sbs member
+    std::vector<Node*> _grouped; // children ordered by group
 };
 
 
@@ -210,25 +403,34 @@ class XmlDecoder {
 public:
     template <class T>
     bool decode(const std::string&str, T&val, bool with_root=false) {
-        std::string tmp = str;
-        return this->decode_indata(tmp, val, with_root);
+        return this->decode(str.c_str(), val, with_root);
+    }
+    // data must be null terminated, it is not modified(e.g. mmapped file) and must live until decode return
+    template <class T>
+    bool decode(const char *data, T&val, bool with_root=false) {
+        return this->decode_indata<rapidxml::parse_non_destructive>(const_cast<char*>(data), val, with_root);
+    }
+    // parse the mutable and null terminated data in place, the data is modified
+    template <class T>
+    bool decode_inplace(char *data, T&val, bool with_root=false) {
+        return this->decode_indata<0>(data, val, with_root);
     }
     template <class T>
     bool decode_file(const std::string&fname, T&val, bool with_root=false) {
         std::string data;
         bool ret = Util::readfile(fname, data);
         if (ret) {
-            ret = this->decode_indata(data, val, with_root);
+            ret = this->decode_indata<0>((char*)data.c_str(), val, with_root);
         }
         return ret;
     }
 private:
-    template <class T>
-    bool decode_indata(std::string&str, T&val, bool with_root=false) {
+    template <int Flags, class T>
+    bool decode_indata(char *data, T&val, bool with_root=false) {
         rapidxml::xml_document<> de;
         std::string err;
         try {
-            de.parse<0>((char*)str.c_str());
+            de.parse<Flags>(data);
         } catch (const rapidxml::parse_error&e) {
             err = std::string("parse xml fail. err=")+e.what()+". "+std::string(e.where<char>()).substr(0, 32);
         } catch (const std::exception&e) {
@@ -239,11 +441,12 @@ private:
             throw std::runtime_error(err);
         }
 
+        bool raw = (0 != (Flags&rapidxml::parse_no_string_terminators));
         if (!with_root) {
-            XmlNode node(de.first_node());
+            XmlNode node(de.first_node(), raw);
             return XDecoder<XmlNode>(NULL, (const char*)NULL, node).decode(val, NULL);
         } else { 
-            XmlNode node(&de);
+            XmlNode node(&de, raw);
             return XDecoder<XmlNode>(NULL, (const char*)NULL, node).decode(val, NULL);
         }
     }
@@ -19,7 +19,9 @@
 
 #include <list>
 #include <sstream>
+#include <vector>
 #include "xencoder.h"
+#include "xml_escape.h"
 
 
 namespace xpack {
@@ -54,6 +56,7 @@ class XmlWriter {
 
     friend class XEncoder<XmlWriter>;
     friend class XmlEncoder;
+    friend class XmlStreamWriter;
     const static bool support_null = false;
 public:
     XmlWriter(int indentCount = -1, char indentChar = ' ', int decimalPlaces = 324):_indentCount(indentCount),_indentChar(indentChar),_decimalPlaces(decimalPlaces) {
@@ -181,10 +184,7 @@ private:
         if (val==0 && Extend::OmitEmpty(ext)) {
             return false;
         } else {
-            std::ostringstream os;
-            os.precision(_decimalPlaces+1);
-            os<<val;
-            std::string fval = os.str();
+            std::string fval = float_string(val, _decimalPlaces);
 
             if (Extend::Attribute(ext)) {
                 _cur->attrs.push_back(Attr(key, fval));
@@ -199,55 +199,24 @@ private:
         return true;
     }
 
+    // decimalPlaces: max decimal places, same as rapidjson Writer
+    template <class T>
+    static std::string float_string(const T &val, int decimalPlaces) {
+        char buf[64];
+        return std::string(buf, Util::dtoa((double)val, buf, decimalPlaces));
+    }
+
     // escape string
     static std::string string_quote(const std::string &val) {
         std::string ret;
-        ret.reserve(val.length()*2);
-
-        for (size_t i=0; i<val.length(); ++i) {
-            int c = (int)(val[i]) & 0xFF;
-            switch (c) {
-              case '<':
-                ret += "&lt;";
-                break;
-              case '>':
-                ret += "&gt;";
-                break;
-              case '&':
-                ret += "&amp;";
-                break;
-              case '\'':
-                ret += "&apos;";
-                break;
-              case '\"':
-                ret += "&quot;";
-                break;
-              default:
-                if(c >= ' ') {
-                    ret.push_back(val[i]);
-                } else {
-                    ret += "\\x";
-                    unsigned char uch = (unsigned char)val[i];
-                    unsigned char h = (uch>>4)&0xf;
-                    unsigned char l = uch&0xf;
-                    if (h < 10) {
-                        ret.push_back(h+'0');
-                    } else {
-                        ret.push_back(h-10+'A');
-                    }
-                    if (l < 10) {
-                        ret.push_back(l+'0');
-                    } else {
-                        ret.push_back(l-10+'A');
-                    }
-                }
-            }
-        }
-
+        ret.reserve(val.length());
+        XmlEscape::escape(ret, val.data(), val.length());
         return ret;
     }
-
-
+    // append escaped val to ret
+    static void string_quote(std::string &ret, const std::string &val) {
+        XmlEscape::escape(ret, val.data(), val.length());
+    }
 
     void appendNode(const Node *nd, int depth) {
         bool indentEnd = true;
@@ -334,6 +303,304 @@ private:
     int _decimalPlaces;
 };
 
+/*
+  write xml to output directly while XEncoder drives it, no Node tree.
+  output is the same as XmlWriter, except:
+  - attribute after child element of the same object is inserted back into the start tag(memmove of the
+    output after it), so declare attribute members first is faster
+  - content(X_PACK_FLAG_XML_CONTENT) must not be mixed with child elements
+*/
+class XmlStreamWriter {
+    struct Level {
+        std::string key;     // tag, empty for vector without label
+        std::string vec_key; // key for vector
+        int    depth;        // indent depth of the tag
+        int    cdepth;       // indent depth of child
+        size_t attr_pos;     // position to insert attribute
+        bool   open;         // '>' of start tag not written
+        bool   child;        // has child or content
+        bool   content;      // has content
+        bool   mute;         // ignored by XmlWriter, don't output
+    };
+
+    friend class XEncoder<XmlStreamWriter>;
+    friend class XmlEncoder;
+    const static bool support_null = false;
+public:
+    XmlStreamWriter(int indentCount = -1, char indentChar = ' ', int decimalPlaces = 324):_indentCount(indentCount),_indentChar(indentChar),_decimalPlaces(decimalPlaces),_top(0) {
+        if (_indentCount > 0) {
+            if (_indentChar!=' ' && _indentChar!='\t') {
+                throw std::runtime_error("indentChar must be space or tab");
+            }
+        }
+        _levels.resize(8);
+        Level &root = _levels[0];
+        root.depth = 0;
+        root.cdepth = 0;
+        root.attr_pos = 0;
+        root.open = false;
+        root.child = false;
+        root.content = false;
+        root.mute = false;
+    }
+private:
+    // single use: the buffer is moved out instead of copying the whole document
+    std::string String() {
+        std::string s;
+        s.swap(_output);
+        return s;
+    }
+    inline static const char *Name() {
+        return "xml";
+    }
+    inline const char *IndexKey(size_t index) {
+        (void)index;
+        return _levels[_top].vec_key.c_str();
+    }
+    void ArrayBegin(const char *key, const Extend *ext) {
+        bool inarray = !_levels[_top].vec_key.empty();
+        Level &n = push(key);
+        if (inarray) { // vector<vector<...>>
+            n.vec_key = n.key;
+        } else if (NULL != ext && NULL != ext->alias) {
+            if (!ext->alias->Flag("xml", "vl", &n.vec_key)) {  // forward compatible, support vector label
+                if (ext->alias->Flag("xml", "sbs")) {          // no top label, vector item will side by side
+                    n.vec_key.swap(n.key);
+                } else {
+                    n.vec_key = n.key;
+                }
+            }
+        } else {
+            n.vec_key = n.key;
+        }
+        start(n);
+    }
+    void ArrayEnd(const char *key, const Extend *ext) {
+        (void)key;
+        (void)ext;
+        pop();
+    }
+    void ObjectBegin(const char *key, const Extend *ext) {
+        (void)ext;
+        start(push(key));
+    }
+    void ObjectEnd(const char *key, const Extend *ext) {
+        (void)key;
+        (void)ext;
+        pop();
+    }
+    bool WriteNull(const char*key, const Extend *ext) {
+        static std::string empty;
+        return this->encode_string(key, empty, ext);
+    }
+    // string
+    bool encode_string(const char*key, const std::string &val, const Extend *ext) {
+        if (Extend::Attribute(ext)) {
+            attribute(key, val, true);
+        } else if (Extend::XmlContent(ext)) {
+            content(val.data(), val.length());
+        } else if (!Extend::AliasFlag(ext, "xml", "cdata")) {
+            if (leaf_begin(key, val.empty())) {
+                XmlWriter::string_quote(_output, val);
+                leaf_end(key);
+            }
+        } else {
+            if (leaf_begin(key, false)) {
+                _output += "<![CDATA[";
+                _output += val;
+                _output += "]]>";
+                leaf_end(key);
+            }
+        }
+        return true;
+    }
+    // bool
+    bool encode_bool(const char*key, const bool &val, const Extend *ext) {
+        if (val) {
+            return value(key, "true", 4, ext);
+        } else {
+            return value(key, "false", 5, ext);
+        }
+    }
+    // integer
+    template <class T>
+    typename x_enable_if<numeric<T>::is_integer, bool>::type encode_number(const char*key, const T& val, const Extend *ext) {
+        if (val==0 && Extend::OmitEmpty(ext)) {
+            return false;
+        }
+        char buf[32];
+        return value(key, buf, Util::itoa(val, buf)-buf, ext);
+    }
+    // float
+    template <class T>
+    typename x_enable_if<numeric<T>::is_float, bool>::type encode_number(const char*key, const T &val, const Extend *ext) {
+        if (val==0 && Extend::OmitEmpty(ext)) {
+            return false;
+        }
+        char buf[64];
+        return value(key, buf, Util::dtoa((double)val, buf, _decimalPlaces)-buf, ext);
+    }
+
+    // unescaped value
+    bool value(const char *key, const char *val, size_t len, const Extend *ext) {
+        if (Extend::Attribute(ext)) {
+            attribute(key, std::string(val, len), false);
+        } else if (Extend::XmlContent(ext)) {
+            content(val, len);
+        } else if (leaf_begin(key, len==0)) {
+            _output.append(val, len);
+            leaf_end(key);
+        }
+        return true;
+    }
+
+    Level& push(const char *key) {
+        if (++_top == _levels.size()) {
+            _levels.resize(_levels.size()*2);
+        }
+        Level &n = _levels[_top];
+        n.key.clear();
+        if (NULL != key) {
+            n.key = key;
+        }
+        n.vec_key.clear();
+        n.mute = muted(_levels[_top-1]);
+        return n;
+    }
+    void start(Level &n) {
+        if (n.mute) {
+            return;
+        }
+        Level &p = _levels[_top-1];
+        child(p);
+        n.depth = p.cdepth;
+        if (!n.key.empty()) {
+            indent(n.depth);
+            _output.push_back('<');
+            _output += n.key;
+            n.cdepth = n.depth+1;
+        } else { // same as XmlWriter::appendNode
+            n.cdepth = (n.depth>0) ? n.depth : 1;
+        }
+        n.attr_pos = _output.length();
+        n.open = true;
+        n.child = false;
+        n.content = false;
+    }
+    void pop() {
+        Level &n = _levels[_top--];
+        if (n.mute || n.key.empty()) {
+            return;
+        }
+        if (!n.child) {
+            _output += "/>";
+            return;
+        }
+        if (!n.content) {
+            indent(n.depth);
+        }
+        _output += "</";
+        _output += n.key;
+        _output.push_back('>');
+    }
+
+    // XmlWriter only output first child of root, and ignore childs if has content
+    bool muted(const Level &p) const {
+        return p.mute || p.content || (&p==&_levels[0] && p.child);
+    }
+    void child(Level &p) {
+        if (p.open) {
+            if (!p.key.empty()) {
+                _output.push_back('>');
+            }
+            p.open = false;
+        }
+        p.child = true;
+    }
+
+    bool leaf_begin(const char *key, bool empty) {
+        Level &p = _levels[_top];
+        if (muted(p)) {
+            return false;
+        }
+        child(p);
+        if (NULL == key || *key == '\0') {
+            return true;
+        }
+        indent(p.cdepth);
+        _output.push_back('<');
+        _output += key;
+        if (empty) {
+            _output += "/>";
+            return false;
+        }
+        _output.push_back('>');
+        return true;
+    }
+    void leaf_end(const char *key) {
+        if (NULL != key && *key != '\0') {
+            _output += "</";
+            _output += key;
+            _output.push_back('>');
+        }
+    }
+    void content(const char *val, size_t len) {
+        Level &p = _levels[_top];
+        if (p.mute || len == 0) {
+            return;
+        }
+        child(p);
+        p.content = true;
+        _output.append(val, len);
+    }
+    void attribute(const char *key, const std::string &val, bool quote) {
+        Level &p = _levels[_top];
+        if (p.mute) {
+            return;
+        }
+        if (p.open) {
+            attr_append(_output, key, val, quote);
+            p.attr_pos = _output.length();
+        } else { // start tag finished, insert back
+            std::string attr;
+            attr_append(attr, key, val, quote);
+            _output.insert(p.attr_pos, attr);
+            p.attr_pos += attr.length();
+        }
+    }
+    static void attr_append(std::string &out, const char *key, const std::string &val, bool quote) {
+        out.push_back(' ');
+        out += key;
+        out += "=\"";
+        if (quote) {
+            XmlWriter::string_quote(out, val);
+        } else {
+            out += val;
+        }
+        out.push_back('"');
+    }
+
+    void indent(int depth) {
+        if (_indentCount < 0) {
+            return;
+        }
+        _output.push_back('\n');
+        if (_indentCount == 0) {
+            return;
+        }
+        _output.append((size_t)(depth*_indentCount), _indentChar);
+    }
+
+    std::string _output;
+
+    int  _indentCount;
+    char _indentChar;
+    int _decimalPlaces;
+
+    std::vector<Level> _levels;
+    size_t _top;
+};
+
 
 class XmlEncoder {
 public:
@@ -341,19 +608,31 @@ public:
         indentCount = -1;
         indentChar = ' ';
         maxDecimalPlaces = 324;
+        stream = false;
     }
     XmlEncoder(int _indentCount, char _indentChar, int _maxDecimalPlaces = 324) { // compat
         indentCount = _indentCount;
         indentChar = _indentChar;
         maxDecimalPlaces = _maxDecimalPlaces;
+        stream = false;
     }
 
     void SetMaxDecimalPlaces(int _maxDecimalPlaces) {
         maxDecimalPlaces = _maxDecimalPlaces;
     }
+    // use XmlStreamWriter, write output directly without building Node tree
+    void SetStream(bool _stream) {
+        stream = _stream;
+    }
 
     template <class T>
     std::string encode(const T&val, const std::string&root) {
+        if (stream) {
+            XmlStreamWriter wr(indentCount, indentChar, maxDecimalPlaces);
+            XEncoder<XmlStreamWriter> en(wr);
+            en.encode(root.c_str(), val, NULL);
+            return wr.String();
+        }
         XmlWriter wr(indentCount, indentChar, maxDecimalPlaces);
         XEncoder<XmlWriter> en(wr);
         en.encode(root.c_str(), val, NULL);
@@ -364,6 +643,7 @@ private:
     int indentCount;
     char indentChar;
     int maxDecimalPlaces;
+    bool stream;
 };
 
 }
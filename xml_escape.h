@@ -0,0 +1,212 @@
+/*
+* Copyright (C) 2021 Duowan Inc. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef __X_PACK_XML_ESCAPE_H
+#define __X_PACK_XML_ESCAPE_H
+
+#include <string>
+#include <string.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#define X_PACK_XML_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace xpack {
+
+/*
+  escape/unescape of xml text. clean runs are found by block scan and copied at once,
+  only the special characters go through the slow path.
+*/
+class XmlEscape {
+public:
+    // append escaped [s, s+len) to out. <>&'" are escaped as entity, control characters as \xHH
+    static void escape(std::string &out, const char *s, size_t len) {
+        const char *end = s+len;
+        for (;;) {
+            const char *p = scan(s, end);
+            out.append(s, p-s);
+            if (p == end) {
+                break;
+            }
+
+            unsigned char c = (unsigned char)*p;
+            switch (c) {
+              case '<':
+                out.append("&lt;", 4);
+                break;
+              case '>':
+                out.append("&gt;", 4);
+                break;
+              case '&':
+                out.append("&amp;", 5);
+                break;
+              case '\'':
+                out.append("&apos;", 6);
+                break;
+              case '\"':
+                out.append("&quot;", 6);
+                break;
+              default: {
+                static const char hex[] = "0123456789ABCDEF";
+                char buf[4] = {'\\', 'x', hex[c>>4], hex[c&0xf]};
+                out.append(buf, 4);
+              }
+            }
+            s = p+1;
+        }
+    }
+
+    // append unescaped [s, s+len) to out. same as the entity translation of rapidxml, unknown entity is copied verbatim
+    static void unescape(std::string &out, const char *s, size_t len) {
+        const char *end = s+len;
+        while (s < end) {
+            const char *amp = (const char*)memchr(s, '&', end-s);
+            if (NULL == amp) {
+                out.append(s, end-s);
+                break;
+            }
+            out.append(s, amp-s);
+            s = amp + entity(out, amp, end);
+        }
+    }
+
+private:
+    // first character need escape, or end
+    static const char* scan(const char *s, const char *end) {
+    #ifdef X_PACK_XML_SSE2
+        const __m128i lt = _mm_set1_epi8('<');
+        const __m128i gt = _mm_set1_epi8('>');
+        const __m128i amp = _mm_set1_epi8('&');
+        const __m128i apos = _mm_set1_epi8('\'');
+        const __m128i quot = _mm_set1_epi8('"');
+        const __m128i ctrl = _mm_set1_epi8(0x1F);
+        for (; end-s >= 16; s += 16) {
+            __m128i x = _mm_loadu_si128((const __m128i*)s);
+            __m128i m = _mm_or_si128(_mm_cmpeq_epi8(x, lt), _mm_cmpeq_epi8(x, gt));
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(x, amp));
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(x, apos));
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(x, quot));
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_max_epu8(x, ctrl), ctrl)); // x <= 0x1F
+            int mask = _mm_movemask_epi8(m);
+            if (0 != mask) {
+                return s + __builtin_ctz((unsigned)mask);
+            }
+        }
+    #endif
+        const unsigned char *t = table();
+        for (; s < end && 0 == t[(unsigned char)*s]; ++s) {
+        }
+        return s;
+    }
+    static const unsigned char* table() {
+        static const unsigned char t[256] = {
+            1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+            0,0,1,0,0,0,1,1,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,1,0,1,0, // "&'<>
+        };
+        return t;
+    }
+
+    // append the character of entity at s to out, return the length consumed
+    static size_t entity(std::string &out, const char *s, const char *end) {
+        size_t left = end-s;
+        if (left >= 4) {
+            switch (s[1]) {
+              case 'a':
+                if (left >= 5 && 0 == memcmp(s, "&amp;", 5)) {
+                    out.push_back('&');
+                    return 5;
+                } else if (left >= 6 && 0 == memcmp(s, "&apos;", 6)) {
+                    out.push_back('\'');
+                    return 6;
+                }
+                break;
+              case 'q':
+                if (left >= 6 && 0 == memcmp(s, "&quot;", 6)) {
+                    out.push_back('"');
+                    return 6;
+                }
+                break;
+              case 'g':
+                if (0 == memcmp(s, "&gt;", 4)) {
+                    out.push_back('>');
+                    return 4;
+                }
+                break;
+              case 'l':
+                if (0 == memcmp(s, "&lt;", 4)) {
+                    out.push_back('<');
+                    return 4;
+                }
+                break;
+              case '#':
+                return numeric(out, s, end);
+            }
+        }
+        out.push_back('&');
+        return 1;
+    }
+    // &#ddd; or &#xhh;
+    static size_t numeric(std::string &out, const char *s, const char *end) {
+        bool hex = (s[2] == 'x');
+        const char *p = s + (hex?3:2);
+        unsigned long code = 0;
+        for (; p < end; ++p) {
+            int d = digit(*p, hex);
+            if (d < 0 || code > 0x10FFFF) {
+                break;
+            }
+            code = code*(hex?16:10) + d;
+        }
+        if (p < end && *p == ';' && p > s+(hex?3:2) && code <= 0x10FFFF) {
+            utf8(out, code);
+            return p-s+1;
+        }
+        out.push_back('&');
+        return 1;
+    }
+    static int digit(char c, bool hex) {
+        if (c >= '0' && c <= '9') {
+            return c-'0';
+        } else if (hex && c >= 'a' && c <= 'f') {
+            return c-'a'+10;
+        } else if (hex && c >= 'A' && c <= 'F') {
+            return c-'A'+10;
+        }
+        return -1;
+    }
+    static void utf8(std::string &out, unsigned long code) {
+        if (code < 0x80) {
+            out.push_back((char)code);
+        } else if (code < 0x800) {
+            out.push_back((char)(0xC0 | (code>>6)));
+            out.push_back((char)(0x80 | (code&0x3F)));
+        } else if (code < 0x10000) {
+            out.push_back((char)(0xE0 | (code>>12)));
+            out.push_back((char)(0x80 | ((code>>6)&0x3F)));
+            out.push_back((char)(0x80 | (code&0x3F)));
+        } else {
+            out.push_back((char)(0xF0 | (code>>18)));
+            out.push_back((char)(0x80 | ((code>>12)&0x3F)));
+            out.push_back((char)(0x80 | ((code>>6)&0x3F)));
+            out.push_back((char)(0x80 | (code&0x3F)));
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,232 @@
+/*
+* Copyright (C) 2021 Duowan Inc. All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing,
+* software distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef __X_PACK_XML_READER_H
+#define __X_PACK_XML_READER_H
+
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <string.h>
+
+#include "xml_decoder.h"
+
+namespace xpack {
+
+/*
+  pull reader of the record elements(direct children of the root element) of a huge document.
+  only the current record is kept in memory, other children of the root are skipped.
+  <feed>
+      <item>...</item>
+      <item>...</item>
+  </feed>
+
+  std::ifstream fs("feed.xml");
+  xpack::XmlReader reader(fs, "item");
+  Item item;
+  while (reader.next(item)) {
+      ...
+      item = Item();
+  }
+*/
+class XmlReader {
+public:
+    XmlReader(std::istream &is, const std::string &record, size_t chunk = 64*1024):_is(is), _record(record), _chunk(chunk), _pos(0), _start(0), _depth(0) {
+        if (0 == _chunk) {
+            _chunk = 1;
+        }
+    }
+
+    // decode next record to val, return false if no more record
+    template <class T>
+    bool next(T &val) {
+        size_t start, end;
+        if (!this->next_record(start, end)) {
+            return false;
+        }
+
+        // decode the record in place, the byte after it is the terminator during parsing
+        bool last = (end == _buf.size());
+        char c = last ? '\0' : _buf[end];
+        if (!last) {
+            _buf[end] = '\0';
+        }
+        try {
+            XmlDecoder de;
+            de.decode_inplace(&_buf[start], val);
+        } catch (...) {
+            if (!last) {
+                _buf[end] = c;
+            }
+            throw;
+        }
+        if (!last) {
+            _buf[end] = c;
+        }
+        return true;
+    }
+
+private:
+    // find the next record, [start, end) of _buf. end is the position after '>'
+    bool next_record(size_t &start, size_t &end) {
+        bool in = false;
+        for (;;) {
+            if (!in && _pos >= _chunk) { // keep the memory bounded
+                _buf.erase(0, _pos);
+                _pos = 0;
+            }
+
+            size_t lt = this->find("<", _pos);
+            if (lt == std::string::npos) {
+                if (in || _depth > 0) {
+                    throw std::runtime_error("xml reader: unexpected end of document");
+                }
+                _pos = _buf.size();
+                return false;
+            }
+
+            this->ensure(lt+9);
+            const char *p = _buf.c_str()+lt;
+            if (0 == strncmp(p, "<?", 2)) {
+                _pos = this->skip("?>", lt+2);
+            } else if (0 == strncmp(p, "<!--", 4)) {
+                _pos = this->skip("-->", lt+4);
+            } else if (0 == strncmp(p, "<![CDATA[", 9)) {
+                _pos = this->skip("]]>", lt+9);
+            } else if (0 == strncmp(p, "<!", 2)) {
+                _pos = this->doctype(lt+2);
+            } else if (0 == strncmp(p, "</", 2)) {
+                _pos = this->skip(">", lt+2);
+                if (0 == _depth) {
+                    throw std::runtime_error("xml reader: unexpected end tag");
+                }
+                if (--_depth == 1 && in) {
+                    start = _start;
+                    end = _pos;
+                    return true;
+                }
+            } else {
+                bool self_close;
+                _pos = this->tag(lt+1, self_close);
+                if (1 == _depth && !in && this->is_record(lt+1)) {
+                    in = true;
+                    _start = lt;
+                }
+                if (!self_close) {
+                    ++_depth;
+                } else if (1 == _depth && in) {
+                    start = _start;
+                    end = _pos;
+                    return true;
+                }
+            }
+        }
+    }
+
+    bool fill() {
+        size_t old = _buf.size();
+        _buf.resize(old+_chunk);
+        _is.read(&_buf[old], (std::streamsize)_chunk);
+        size_t n = (size_t)_is.gcount();
+        _buf.resize(old+n);
+        return n > 0;
+    }
+    void ensure(size_t size) {
+        while (_buf.size() < size && this->fill()) {
+        }
+    }
+    size_t find(const char *pat, size_t from) {
+        size_t len = strlen(pat);
+        for (;;) {
+            size_t p = _buf.find(pat, from, len);
+            if (p != std::string::npos) {
+                return p;
+            }
+            if (_buf.size()+1 > from+len) {
+                from = _buf.size()+1-len;
+            }
+            if (!this->fill()) {
+                return std::string::npos;
+            }
+        }
+    }
+    // position after pat
+    size_t skip(const char *pat, size_t from) {
+        size_t p = this->find(pat, from);
+        if (p == std::string::npos) {
+            throw std::runtime_error(std::string("xml reader: unexpected end of document, expect ")+pat);
+        }
+        return p+strlen(pat);
+    }
+    // <!DOCTYPE ...>, may contain [...]
+    size_t doctype(size_t from) {
+        int bracket = 0;
+        for (size_t i=from; ; ++i) {
+            this->ensure(i+1);
+            if (i >= _buf.size()) {
+                throw std::runtime_error("xml reader: unexpected end of document in <!");
+            }
+            char c = _buf[i];
+            if (c == '[') {
+                ++bracket;
+            } else if (c == ']') {
+                --bracket;
+            } else if (c == '>' && bracket <= 0) {
+                return i+1;
+            }
+        }
+    }
+    // start tag, '>' in quoted attribute value is skipped
+    size_t tag(size_t from, bool &self_close) {
+        char quote = 0;
+        for (size_t i=from; ; ++i) {
+            this->ensure(i+1);
+            if (i >= _buf.size()) {
+                throw std::runtime_error("xml reader: unexpected end of document in tag");
+            }
+            char c = _buf[i];
+            if (0 != quote) {
+                if (c == quote) {
+                    quote = 0;
+                }
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '>') {
+                self_close = (_buf[i-1] == '/');
+                return i+1;
+            }
+        }
+    }
+    bool is_record(size_t name) const {
+        if (0 != _buf.compare(name, _record.size(), _record)) {
+            return false;
+        }
+        char c = _buf[name+_record.size()]; // tag is complete, so it is valid
+        return c == '>' || c == '/' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    std::istream &_is;
+    std::string _record;
+    size_t _chunk;      // read size
+    std::string _buf;   // unconsumed data
+    size_t _pos;        // scan position in _buf
+    size_t _start;      // start of current record in _buf
+    int _depth;         // number of open elements at _pos, records are at 1
+};
+
+}
+
+#endif
@@ -19,6 +19,8 @@
 #define __X_PACK_H
 
 #include "extend.h"
+#include "field.h"
+#include "instrument.h"
 #include "l1l2_expand.h"
 #include "traits.h"
 
@@ -43,9 +45,9 @@
     --> // expand to convert code
 */
 
-// flag only work for this member
-#define X_EXPAND_FLAG_F(...)    int __x_pack_flag = 0 X_PACK_N2(X_PACK_L2, X_PACK_ACT_FLAG, 0, __VA_ARGS__) ;
+// flag only work for this member, the value is kept in the field table
 #define X_PACK_ACT_FLAG(ARG, F) | X_PACK_FLAG_##F
+#define X_PACK_FLAG_VALUE_F(...) (0 X_PACK_N2(X_PACK_L2, X_PACK_ACT_FLAG, 0, __VA_ARGS__))
 
 /*
   X(F(x,y,z), member1, member2, ....)
@@ -61,12 +63,12 @@
 //=======DECODE
 #define X_PACK_L1_DECODE(x)             { X_PACK_L1_DECODE_##x }
 //----
-#define X_PACK_L1_DECODE_X(FLAG, ...)   X_EXPAND_FLAG_##FLAG xpack::Extend __x_pack_ext(__x_pack_flag, NULL); X_PACK_N2(X_PACK_L2, X_PACK_DECODE_ACT_O, 0, __VA_ARGS__)
-#define X_PACK_L1_DECODE_E(FLAG, ...)   X_EXPAND_FLAG_##FLAG xpack::Extend __x_pack_ext(__x_pack_flag, NULL); X_PACK_N2(X_PACK_L2, X_PACK_DECODE_ACT_E, 0, __VA_ARGS__)
-#define X_PACK_L1_DECODE_B(FLAG, ...)   X_EXPAND_FLAG_##FLAG xpack::Extend __x_pack_ext(__x_pack_flag, NULL); X_PACK_N2(X_PACK_L2, X_PACK_DECODE_ACT_B, 0, __VA_ARGS__)
-#define X_PACK_L1_DECODE_AF(FLAG, ...)  X_EXPAND_FLAG_##FLAG X_PACK_N2(X_PACK_L2_2, X_PACK_DECODE_ACT_A, 0, __VA_ARGS__) // extend define in ACTION
+#define X_PACK_L1_DECODE_X(FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_DECODE_ACT_O, 0, __VA_ARGS__)
+#define X_PACK_L1_DECODE_E(FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_DECODE_ACT_E, 0, __VA_ARGS__)
+#define X_PACK_L1_DECODE_B(FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_DECODE_ACT_B, 0, __VA_ARGS__)
+#define X_PACK_L1_DECODE_AF(FLAG, ...)  X_PACK_N2(X_PACK_L2_2, X_PACK_DECODE_ACT_A, 0, __VA_ARGS__)
 //-----customer decoder---------
-#define X_PACK_L1_DECODE_C(CUSTOM, FLAG, ...)   X_EXPAND_FLAG_##FLAG xpack::Extend __x_pack_ext(__x_pack_flag, NULL); X_PACK_N2(X_PACK_L2, X_PACK_DECODE_ACT_C, CUSTOM, __VA_ARGS__)
+#define X_PACK_L1_DECODE_C(CUSTOM, FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_DECODE_ACT_C, CUSTOM, __VA_ARGS__)
 
 #define X_PACK_L1_DECODE_O(...)         X_PACK_L1_DECODE_X(F(0), __VA_ARGS__)
 #define X_PACK_L1_DECODE_M(...)         X_PACK_L1_DECODE_X(F(M), __VA_ARGS__)
@@ -76,11 +78,11 @@
 //=======ENCODE
 #define X_PACK_L1_ENCODE(x) { X_PACK_L1_ENCODE_##x }
 //-----
-#define X_PACK_L1_ENCODE_X(FLAG, ...)   X_EXPAND_FLAG_##FLAG xpack::Extend __x_pack_ext(__x_pack_flag, NULL); X_PACK_N2(X_PACK_L2, X_PACK_ENCODE_ACT_O, 0, __VA_ARGS__)
-#define X_PACK_L1_ENCODE_E(FLAG, ...)   X_EXPAND_FLAG_##FLAG xpack::Extend __x_pack_ext(__x_pack_flag, NULL); X_PACK_N2(X_PACK_L2, X_PACK_ENCODE_ACT_E, 0, __VA_ARGS__)
-#define X_PACK_L1_ENCODE_B(FLAG, ...)   X_EXPAND_FLAG_##FLAG xpack::Extend __x_pack_ext(__x_pack_flag, NULL); X_PACK_N2(X_PACK_L2, X_PACK_ENCODE_ACT_B, 0, __VA_ARGS__)
-#define X_PACK_L1_ENCODE_AF(FLAG, ...)  X_EXPAND_FLAG_##FLAG X_PACK_N2(X_PACK_L2_2, X_PACK_ENCODE_ACT_A, 0, __VA_ARGS__) // extend define in ACTION
-#define X_PACK_L1_ENCODE_C(CUSTOM, FLAG, ...)   X_EXPAND_FLAG_##FLAG xpack::Extend __x_pack_ext(__x_pack_flag, NULL); X_PACK_N2(X_PACK_L2, X_PACK_ENCODE_ACT_C, CUSTOM, __VA_ARGS__)
+#define X_PACK_L1_ENCODE_X(FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_ENCODE_ACT_O, 0, __VA_ARGS__)
+#define X_PACK_L1_ENCODE_E(FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_ENCODE_ACT_E, 0, __VA_ARGS__)
+#define X_PACK_L1_ENCODE_B(FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_ENCODE_ACT_B, 0, __VA_ARGS__)
+#define X_PACK_L1_ENCODE_AF(FLAG, ...)  X_PACK_N2(X_PACK_L2_2, X_PACK_ENCODE_ACT_A, 0, __VA_ARGS__)
+#define X_PACK_L1_ENCODE_C(CUSTOM, FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_ENCODE_ACT_C, CUSTOM, __VA_ARGS__)
 
 #define X_PACK_L1_ENCODE_O(...)         X_PACK_L1_ENCODE_X(F(0), __VA_ARGS__)
 #define X_PACK_L1_ENCODE_M(...)         X_PACK_L1_ENCODE_X(F(M), __VA_ARGS__)
@@ -88,75 +90,154 @@
 //-----
 #define X_PACK_L1_ENCODE_I(...)         X_PACK_N2(X_PACK_L2, X_PACK_ENCODE_ACT_I, 0, __VA_ARGS__)
 
+//=======FIELD TABLE
+#define X_PACK_L1_FIELD(x) X_PACK_L1_FIELD_##x
+//-----
+#define X_PACK_L1_FIELD_X(FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_FIELD_ACT_O, X_PACK_FLAG_VALUE_##FLAG, __VA_ARGS__)
+#define X_PACK_L1_FIELD_E(FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_FIELD_ACT_E, X_PACK_FLAG_VALUE_##FLAG, __VA_ARGS__)
+#define X_PACK_L1_FIELD_B(FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_FIELD_ACT_B, X_PACK_FLAG_VALUE_##FLAG, __VA_ARGS__)
+#define X_PACK_L1_FIELD_AF(FLAG, ...)  X_PACK_N2(X_PACK_L2_2, X_PACK_FIELD_ACT_A, X_PACK_FLAG_VALUE_##FLAG, __VA_ARGS__)
+#define X_PACK_L1_FIELD_C(CUSTOM, FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_FIELD_ACT_C, X_PACK_FLAG_VALUE_##FLAG, __VA_ARGS__)
+
+#define X_PACK_L1_FIELD_O(...)         X_PACK_L1_FIELD_X(F(0), __VA_ARGS__)
+#define X_PACK_L1_FIELD_M(...)         X_PACK_L1_FIELD_X(F(M), __VA_ARGS__)
+#define X_PACK_L1_FIELD_A(...)         X_PACK_L1_FIELD_AF(F(0), __VA_ARGS__)
+//-----
+#define X_PACK_L1_FIELD_I(...)         X_PACK_N2(X_PACK_L2, X_PACK_FIELD_ACT_I, 0, __VA_ARGS__)
+//=======VISIT
+#define X_PACK_L1_VISIT(x) { X_PACK_L1_VISIT_##x }
+//-----
+#define X_PACK_L1_VISIT_X(FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_VISIT_ACT_O, 0, __VA_ARGS__)
+#define X_PACK_L1_VISIT_E(FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_VISIT_ACT_O, 0, __VA_ARGS__)
+#define X_PACK_L1_VISIT_B(FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_VISIT_ACT_B, 0, __VA_ARGS__)
+#define X_PACK_L1_VISIT_AF(FLAG, ...)  X_PACK_N2(X_PACK_L2_2, X_PACK_VISIT_ACT_A, 0, __VA_ARGS__)
+#define X_PACK_L1_VISIT_C(CUSTOM, FLAG, ...)   X_PACK_N2(X_PACK_L2, X_PACK_VISIT_ACT_O, 0, __VA_ARGS__)
+
+#define X_PACK_L1_VISIT_O(...)         X_PACK_L1_VISIT_X(F(0), __VA_ARGS__)
+#define X_PACK_L1_VISIT_M(...)         X_PACK_L1_VISIT_X(F(M), __VA_ARGS__)
+#define X_PACK_L1_VISIT_A(...)         X_PACK_L1_VISIT_AF(F(0), __VA_ARGS__)
+//-----
+#define X_PACK_L1_VISIT_I(...)         X_PACK_N2(X_PACK_L2, X_PACK_VISIT_ACT_I, 0, __VA_ARGS__)
+
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~ decode act ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// X_PACK_INSTRUMENT_FIELD is empty unless XPACK_INSTRUMENT_FIELD defined, see instrument.h
+// each act takes the next step of __x_pack_plan(see FieldPlan), in the same order as the field table
+#define X_PACK_STEP(S) const xpack::FieldPlan::Step &S = __x_pack_plan[__x_pack_step++];
+
 #define X_PACK_DECODE_ACT_O(ARG, M)                        \
-        __x_pack_ret |= __x_pack_obj.decode(#M, __x_pack_self.M, &__x_pack_ext);
+    {                                                      \
+        X_PACK_INSTRUMENT_FIELD(DECODE, M)                 \
+        X_PACK_STEP(__x_pack_s)                            \
+        __x_pack_ret |= __x_pack_obj.decode(__x_pack_s.name, __x_pack_self.M, &__x_pack_s.ext); \
+    }
 
 #define X_PACK_DECODE_ACT_C(CUSTOM, M)                     \
-        __x_pack_ret |= CUSTOM##_decode(__x_pack_obj, __x_pack_self, #M, __x_pack_self.M, &__x_pack_ext);
+    {                                                      \
+        X_PACK_INSTRUMENT_FIELD(DECODE, M)                 \
+        X_PACK_STEP(__x_pack_s)                            \
+        __x_pack_ret |= CUSTOM##_decode(__x_pack_obj, __x_pack_self, __x_pack_s.name, __x_pack_self.M, &__x_pack_s.ext); \
+    }
 
 // enum for not support c++11
 #ifndef X_PACK_SUPPORT_CXX0X
 #define X_PACK_DECODE_ACT_E(ARG, M)                        \
-        __x_pack_ret |= __x_pack_obj.decode(#M, *((int*)&__x_pack_self.M), &__x_pack_ext);
+    {                                                      \
+        X_PACK_INSTRUMENT_FIELD(DECODE, M)                 \
+        X_PACK_STEP(__x_pack_s)                            \
+        __x_pack_ret |= __x_pack_obj.decode(__x_pack_s.name, *((int*)&__x_pack_self.M), &__x_pack_s.ext); \
+    }
 #else
 #define X_PACK_DECODE_ACT_E X_PACK_DECODE_ACT_O
 #endif
 
-#define X_PACK_DECODE_ACT_A(ARG, M, NAME)                                  \
-    {                                                                      \
-        static xpack::Alias __x_pack_alias(#M, NAME);                      \
-        xpack::Extend __x_pack_ext(__x_pack_flag, &__x_pack_alias);        \
-        const char *__new_name = __x_pack_alias.Name(__x_pack_obj.Name());\
-        __x_pack_ret |= __x_pack_obj.decode(__new_name, __x_pack_self.M, &__x_pack_ext);   \
-    }
+// name of the step is the alias resolved for this decoder
+#define X_PACK_DECODE_ACT_A(ARG, M, NAME) X_PACK_DECODE_ACT_O(ARG, M)
 
-// Inheritance B::__x_pack_decode(__x_pack_obj)
-#define X_PACK_DECODE_ACT_I(ARG, P)                                                                        \
-        {                                                                                                  \
-            xpack::Extend __x_pack_tmp_ext(0,NULL); __x_pack_tmp_ext.ctrl_flag |= X_PACK_CTRL_FLAG_INHERIT;\
-            __x_pack_ret |= __x_pack_obj.decode(static_cast<P&>(__x_pack_self), &__x_pack_tmp_ext);                  \
+// Inheritance B::__x_pack_decode(__x_pack_obj), the step has X_PACK_CTRL_FLAG_INHERIT
+#define X_PACK_DECODE_ACT_I(ARG, P)                                                    \
+        {                                                                              \
+            X_PACK_STEP(__x_pack_s)                                                    \
+            __x_pack_ret |= __x_pack_obj.decode(static_cast<P&>(__x_pack_self), &__x_pack_s.ext); \
         }
 
 // bitfield, not support alias
 #define X_PACK_DECODE_ACT_B(ARG, B)                           \
     {                                                         \
-        x_pack_decltype(__x_pack_self.B) __x_pack_tmp = 0;    \
-        __x_pack_ret |= __x_pack_obj.decode(#B, __x_pack_tmp, &__x_pack_ext); \
+        X_PACK_INSTRUMENT_FIELD(DECODE, B)                    \
+        X_PACK_STEP(__x_pack_s)                               \
+        x_pack_decltype(__x_pack_self.B) __x_pack_tmp = __x_pack_self.B; /* untouched if absent */ \
+        __x_pack_ret |= __x_pack_obj.decode(__x_pack_s.name, __x_pack_tmp, &__x_pack_s.ext); \
         __x_pack_self.B = __x_pack_tmp;\
     }
 
 // ~~~~~~~~~~~~~~~~~~~~~~~ encode act ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #define X_PACK_ENCODE_ACT_O(ARG, M)                        \
-        __x_pack_ret |= __x_pack_obj.encode(#M, __x_pack_self.M, &__x_pack_ext);
-#define X_PACK_ENCODE_ACT_C(CUSTOM, M)                        \
-        __x_pack_ret |= CUSTOM##_encode(__x_pack_obj, __x_pack_self, #M, __x_pack_self.M, &__x_pack_ext);
+    {                                                      \
+        X_PACK_INSTRUMENT_FIELD(ENCODE, M)                 \
+        X_PACK_STEP(__x_pack_s)                            \
+        __x_pack_ret |= __x_pack_obj.encode(__x_pack_s.name, __x_pack_self.M, &__x_pack_s.ext); \
+    }
+#define X_PACK_ENCODE_ACT_C(CUSTOM, M)                     \
+    {                                                      \
+        X_PACK_INSTRUMENT_FIELD(ENCODE, M)                 \
+        X_PACK_STEP(__x_pack_s)                            \
+        __x_pack_ret |= CUSTOM##_encode(__x_pack_obj, __x_pack_self, __x_pack_s.name, __x_pack_self.M, &__x_pack_s.ext); \
+    }
 
 #ifndef X_PACK_SUPPORT_CXX0X
 #define X_PACK_ENCODE_ACT_E(ARG, M)                        \
-        __x_pack_ret |= __x_pack_obj.encode(#M, (const int&)__x_pack_self.M, &__x_pack_ext);
+    {                                                      \
+        X_PACK_INSTRUMENT_FIELD(ENCODE, M)                 \
+        X_PACK_STEP(__x_pack_s)                            \
+        __x_pack_ret |= __x_pack_obj.encode(__x_pack_s.name, (const int&)__x_pack_self.M, &__x_pack_s.ext); \
+    }
 #else
 #define X_PACK_ENCODE_ACT_E X_PACK_ENCODE_ACT_O
 #endif
 
-#define X_PACK_ENCODE_ACT_A(ARG, M, NAME)                                  \
-    {                                                                      \
-        static xpack::Alias __x_pack_alias(#M, NAME);                      \
-        xpack::Extend __x_pack_ext(__x_pack_flag, &__x_pack_alias);        \
-        const char *__new_name = __x_pack_alias.Name(__x_pack_obj.Name());\
-        __x_pack_ret |= __x_pack_obj.encode(__new_name, __x_pack_self.M, &__x_pack_ext);   \
-    }
+#define X_PACK_ENCODE_ACT_A(ARG, M, NAME) X_PACK_ENCODE_ACT_O(ARG, M)
 
-#define X_PACK_ENCODE_ACT_B(ARG, M)      \
-        __x_pack_obj.encode(#M, __x_pack_self.M, &__x_pack_ext);
+#define X_PACK_ENCODE_ACT_B(ARG, M)                        \
+    {                                                      \
+        X_PACK_INSTRUMENT_FIELD(ENCODE, M)                 \
+        X_PACK_STEP(__x_pack_s)                            \
+        __x_pack_obj.encode(__x_pack_s.name, __x_pack_self.M, &__x_pack_s.ext); \
+    }
 
-#define X_PACK_ENCODE_ACT_I(ARG, P)                                                                        \
-        {                                                                                                  \
-            xpack::Extend __x_pack_tmp_ext(0,NULL); __x_pack_tmp_ext.ctrl_flag |= X_PACK_CTRL_FLAG_INHERIT;\
-            __x_pack_ret |= __x_pack_obj.encode(NULL, static_cast<const P&>(__x_pack_self), &__x_pack_tmp_ext);            \
+#define X_PACK_ENCODE_ACT_I(ARG, P)                                                    \
+        {                                                                              \
+            X_PACK_STEP(__x_pack_s)                                                    \
+            __x_pack_ret |= __x_pack_obj.encode(NULL, static_cast<const P&>(__x_pack_self), &__x_pack_s.ext); \
         }
 
+// ~~~~~~~~~~~~~~~~~~~~~~~ field act ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#define X_PACK_FIELD_ACT_O(FLAG, M)       {#M, NULL, FLAG, X_PACK_FIELD_KIND_O},
+#define X_PACK_FIELD_ACT_E(FLAG, M)       {#M, NULL, FLAG, X_PACK_FIELD_KIND_E},
+#define X_PACK_FIELD_ACT_C(FLAG, M)       {#M, NULL, FLAG, X_PACK_FIELD_KIND_C},
+#define X_PACK_FIELD_ACT_B(FLAG, M)       {#M, NULL, FLAG, X_PACK_FIELD_KIND_B},
+#define X_PACK_FIELD_ACT_A(FLAG, M, NAME) {#M, NAME, FLAG, X_PACK_FIELD_KIND_A},
+#define X_PACK_FIELD_ACT_I(ARG, P)        {#P, NULL, 0, X_PACK_FIELD_KIND_I},
+
+// ~~~~~~~~~~~~~~~~~~~~~~~ visit act ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#define X_PACK_VISIT_ACT_O(ARG, M)                        \
+        __x_pack_visitor(*__x_pack_field++, __x_pack_self.M);
+
+#define X_PACK_VISIT_ACT_A(ARG, M, NAME)                  \
+        __x_pack_visitor(*__x_pack_field++, __x_pack_self.M);
+
+// no reference to bitfield, visit a copy. only write back if changed, so visit const object is safe
+#define X_PACK_VISIT_ACT_B(ARG, B)                                    \
+    {                                                                 \
+        x_pack_decltype(__x_pack_self.B) __x_pack_tmp = __x_pack_self.B; \
+        __x_pack_visitor(*__x_pack_field++, __x_pack_tmp);            \
+        if (__x_pack_tmp != __x_pack_self.B) __x_pack_self.B = __x_pack_tmp; \
+    }
+
+#define X_PACK_VISIT_ACT_I(ARG, P)                                    \
+        ++__x_pack_field; xpack::visit(static_cast<P&>(__x_pack_self), __x_pack_visitor);
+
+
 
 // for mark defined XPACK
 #define X_PACK_COMMON \
@@ -166,35 +247,69 @@ public:               \
 // decode function
 #define X_PACK_DECODE_BEGIN                         \
     template<class __X_PACK_DOC, class __X_PACK_ME> \
-    bool __x_pack_decode(__X_PACK_DOC& __x_pack_obj, __X_PACK_ME &__x_pack_self, const xpack::Extend *__x_pack_extp) {(void)__x_pack_extp; bool __x_pack_ret = false;
+    bool __x_pack_decode(__X_PACK_DOC& __x_pack_obj, __X_PACK_ME &__x_pack_self, const xpack::Extend *__x_pack_extp) {(void)__x_pack_extp; bool __x_pack_ret = false; \
+        static const xpack::FieldPlan __x_pack_plan(&__x_pack_fields, xpack::x_coder_name(__x_pack_obj)); size_t __x_pack_step = 0;
 
 // encode function
 #define X_PACK_ENCODE_BEGIN                          \
     template <class __X_PACK_DOC, class __X_PACK_ME> \
-    bool __x_pack_encode(__X_PACK_DOC& __x_pack_obj, const __X_PACK_ME &__x_pack_self, const xpack::Extend *__x_pack_extp) const {(void)__x_pack_extp; bool __x_pack_ret = false;
+    bool __x_pack_encode(__X_PACK_DOC& __x_pack_obj, const __X_PACK_ME &__x_pack_self, const xpack::Extend *__x_pack_extp) const {(void)__x_pack_extp; bool __x_pack_ret = false; \
+        static const xpack::FieldPlan __x_pack_plan(&__x_pack_fields, xpack::x_coder_name(__x_pack_obj)); size_t __x_pack_step = 0;
 
 
 // out decode function
 #define X_PACK_DECODE_BEGIN_OUT(NAME) \
     template<typename __X_PACK_DOC>   \
-    bool __x_pack_decode_out(__X_PACK_DOC& __x_pack_obj, NAME & __x_pack_self, const xpack::Extend *__x_pack_extp) {(void)__x_pack_extp; bool __x_pack_ret = false;
+    bool __x_pack_decode_out(__X_PACK_DOC& __x_pack_obj, NAME & __x_pack_self, const xpack::Extend *__x_pack_extp) {(void)__x_pack_extp; bool __x_pack_ret = false; \
+        static const xpack::FieldPlan __x_pack_plan(&__x_pack_fields_out<NAME>, xpack::x_coder_name(__x_pack_obj)); size_t __x_pack_step = 0;
 
 // out encode function
 #define X_PACK_ENCODE_BEGIN_OUT(NAME)  \
     template <class __X_PACK_DOC>      \
-    bool __x_pack_encode_out(__X_PACK_DOC& __x_pack_obj, const NAME &__x_pack_self, const xpack::Extend *__x_pack_extp) {(void)__x_pack_extp; bool __x_pack_ret = false;
+    bool __x_pack_encode_out(__X_PACK_DOC& __x_pack_obj, const NAME &__x_pack_self, const xpack::Extend *__x_pack_extp) {(void)__x_pack_extp; bool __x_pack_ret = false; \
+        static const xpack::FieldPlan __x_pack_plan(&__x_pack_fields_out<NAME>, xpack::x_coder_name(__x_pack_obj)); size_t __x_pack_step = 0;
+
+// field table
+#define X_PACK_FIELDS_BEGIN                                       \
+    static const xpack::Field* __x_pack_fields(size_t &__x_pack_num) { \
+        static const xpack::Field __x_pack_f[] = {
+
+#define X_PACK_FIELDS_END                                         \
+        };                                                        \
+        __x_pack_num = sizeof(__x_pack_f)/sizeof(__x_pack_f[0]);  \
+        return __x_pack_f;                                        \
+    }
+
+// visit function
+#define X_PACK_VISIT_BEGIN                            \
+    template <class __X_PACK_VISITOR, class __X_PACK_ME> \
+    void __x_pack_visit(const xpack::Field *__x_pack_field, __X_PACK_VISITOR &__x_pack_visitor, __X_PACK_ME &__x_pack_self) {
+
+// out field table
+#define X_PACK_FIELDS_BEGIN_OUT(NAME)                                               \
+    template <> inline const Field* __x_pack_fields_out<NAME>(size_t &__x_pack_num) { \
+        static const xpack::Field __x_pack_f[] = {
+
+// out visit function
+#define X_PACK_VISIT_BEGIN_OUT(NAME)     \
+    template <class __X_PACK_VISITOR>    \
+    void __x_pack_visit_out(const Field *__x_pack_field, __X_PACK_VISITOR &__x_pack_visitor, NAME &__x_pack_self) {
 
 
 #define XPACK(...)   \
     X_PACK_COMMON    \
     X_PACK_DECODE_BEGIN X_PACK_N(X_PACK_L1, X_PACK_L1_DECODE, __VA_ARGS__) return __x_pack_ret; }  \
-    X_PACK_ENCODE_BEGIN X_PACK_N(X_PACK_L1, X_PACK_L1_ENCODE, __VA_ARGS__) return __x_pack_ret; }
+    X_PACK_ENCODE_BEGIN X_PACK_N(X_PACK_L1, X_PACK_L1_ENCODE, __VA_ARGS__) return __x_pack_ret; }  \
+    X_PACK_FIELDS_BEGIN X_PACK_N(X_PACK_L1, X_PACK_L1_FIELD, __VA_ARGS__) X_PACK_FIELDS_END         \
+    X_PACK_VISIT_BEGIN X_PACK_N(X_PACK_L1, X_PACK_L1_VISIT, __VA_ARGS__) }
 
 #define XPACK_OUT(NAME, ...)   \
 namespace xpack {              \
     template<> struct is_xpack_out<NAME> {static bool const value = true;}; \
+    X_PACK_FIELDS_BEGIN_OUT(NAME) X_PACK_N(X_PACK_L1, X_PACK_L1_FIELD, __VA_ARGS__) X_PACK_FIELDS_END       \
     X_PACK_DECODE_BEGIN_OUT(NAME) X_PACK_N(X_PACK_L1, X_PACK_L1_DECODE, __VA_ARGS__) return __x_pack_ret; }  \
     X_PACK_ENCODE_BEGIN_OUT(NAME) X_PACK_N(X_PACK_L1, X_PACK_L1_ENCODE, __VA_ARGS__) return __x_pack_ret; }  \
+    X_PACK_VISIT_BEGIN_OUT(NAME) X_PACK_N(X_PACK_L1, X_PACK_L1_VISIT, __VA_ARGS__) }                        \
 }
 
 #endif
@@ -27,6 +27,7 @@ class yaml {
 public:
     template <class T>
     static void decode(const std::string &data, T &val) {
+        X_PACK_INSTRUMENT_BYTES(DECODE, T, data.size())
         YamlDecoder de;
         de.decode(data, val);
     }
@@ -36,10 +37,25 @@ public:
         de.decode_file(file_name, val);
     }
 
+    // decode every document of the stream and call f(T&) for each, return the number of documents
+    template <class T, class F>
+    static size_t decode_all(std::istream &is, F f) {
+        YamlDecoder de;
+        return de.decode_all<T>(is, f);
+    }
+    template <class T, class F>
+    static size_t decode_all(const std::string &data, F f) {
+        X_PACK_INSTRUMENT_BYTES(DECODE, T, data.size())
+        YamlDecoder de;
+        return de.decode_all<T>(data, f);
+    }
+
     template <class T>
     static std::string encode(const T &val) {
         YamlEncoder en;
-        return en.encode(val);
+        std::string s = en.encode(val);
+        X_PACK_INSTRUMENT_BYTES(ENCODE, T, s.size())
+        return s;
     }
 };
 
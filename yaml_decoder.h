@@ -17,12 +17,26 @@
 #ifndef __X_PACK_YAML_DECODER_H
 #define __X_PACK_YAML_DECODER_H
 
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <streambuf>
+#include <string.h>
+
 #include "yaml-cpp/yaml.h"
+#include "yaml-cpp/eventhandler.h"
 #include "xdecoder.h"
 
-namespace xpack {
+// YamlEventNode::Find starts from the key after last hit only if the map has no more pairs than it
+#ifndef X_PACK_YAML_CURSOR_THRESHOLD
+#define X_PACK_YAML_CURSOR_THRESHOLD 16
+#endif
 
+namespace xpack {
 
+// decode from a YAML::Node, see YamlDecoder::decode(const YAML::Node&, T&)
 class YamlNode {
     typedef XDecoder<YamlNode> decoder;
 public:
@@ -95,28 +109,485 @@ private:
     bool valid;
 };
 
-class YamlDecoder {
+/*
+  flat document built from the events of YAML::Parser, it is much cheaper than the
+  YAML::Node graph: one array of items and one buffer of all the scalars.
+  children follow their parent, a map has key, value, key, value...
+*/
+class YamlDocument:public YAML::EventHandler {
+public:
+    enum {NUL, SCALAR, SEQ, MAP, ALIAS};
+    struct Item {
+        int type;
+        int line;       // position for error message
+        int column;
+        size_t off;     // SCALAR: offset of the value in text(null terminated). ALIAS: index of the target
+        size_t len;     // SCALAR: length of the value
+        size_t size;    // SEQ: number of elements. MAP: number of pairs
+        size_t next;    // index after the subtree
+    };
+
+    // parse next document of the parser, return false if no more document
+    bool Load(YAML::Parser &parser) {
+        _items.clear();
+        _text.clear();
+        _stack.clear();
+        _anchors.clear();
+        return parser.HandleNextDocument(*this);
+    }
+    bool Empty() const {
+        return _items.empty();
+    }
+    const Item& At(size_t index) const {
+        return _items[index];
+    }
+    const char *Text(const Item &item) const {
+        return _text.data()+item.off;
+    }
+    // alias is resolved to its target
+    size_t Resolve(size_t index) const {
+        return _items[index].type == ALIAS ? _items[index].off : index;
+    }
+
+    virtual void OnDocumentStart(const YAML::Mark&) {}
+    virtual void OnDocumentEnd() {}
+    virtual void OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) {
+        this->push(NUL, mark, anchor);
+    }
+    virtual void OnAlias(const YAML::Mark& mark, YAML::anchor_t anchor) {
+        size_t i = this->push(ALIAS, mark, 0);
+        _items[i].off = (anchor < _anchors.size()) ? _anchors[anchor] : i; // unknown anchor is rejected by the parser
+        if (_items[i].off == i) {
+            _items[i].type = NUL;
+        }
+    }
+    virtual void OnScalar(const YAML::Mark& mark, const std::string&, YAML::anchor_t anchor, const std::string& value) {
+        size_t i = this->push(SCALAR, mark, anchor);
+        _items[i].off = _text.size();
+        _items[i].len = value.length();
+        _text.append(value);
+        _text.push_back('\0');
+    }
+    virtual void OnSequenceStart(const YAML::Mark& mark, const std::string&, YAML::anchor_t anchor, YAML::EmitterStyle::value) {
+        _stack.push_back(this->push(SEQ, mark, anchor));
+    }
+    virtual void OnSequenceEnd() {
+        this->pop();
+    }
+    virtual void OnMapStart(const YAML::Mark& mark, const std::string&, YAML::anchor_t anchor, YAML::EmitterStyle::value) {
+        _stack.push_back(this->push(MAP, mark, anchor));
+    }
+    virtual void OnMapEnd() {
+        size_t i = this->pop();
+        _items[i].size /= 2;
+    }
+
+private:
+    size_t push(int type, const YAML::Mark& mark, YAML::anchor_t anchor) {
+        size_t i = _items.size();
+        Item item = {type, mark.line, mark.column, 0, 0, 0, i+1};
+        _items.push_back(item);
+        if (!_stack.empty()) {
+            ++_items[_stack.back()].size;
+        }
+        if (0 != anchor) {
+            if (_anchors.size() <= anchor) {
+                _anchors.resize(anchor+1, 0);
+            }
+            _anchors[anchor] = i;
+        }
+        return i;
+    }
+    size_t pop() {
+        size_t i = _stack.back();
+        _stack.pop_back();
+        _items[i].next = _items.size();
+        return i;
+    }
+
+    std::vector<Item> _items;
+    std::string _text;
+    std::vector<size_t> _stack;     // open SEQ/MAP
+    std::vector<size_t> _anchors;   // anchor id to item index
+};
+
+// node of YamlDocument, scalars are converted by the same rules as YAML::Node::as
+class YamlEventNode {
+    typedef XDecoder<YamlEventNode> decoder;
+    typedef YamlDocument::Item Item;
 public:
+    typedef size_t Iterator;
+
+    YamlEventNode(const YamlDocument *doc=NULL, size_t index=0):_doc(doc), _index(0), _cursor(0), _dup(-1), _at(0), _at_index(0) {
+        if (NULL != doc) {
+            _index = doc->Resolve(index);
+        }
+    }
+
+    inline static const char * Name() {
+        return "yaml";
+    }
+    operator bool() const {
+        return NULL != _doc;
+    }
+    bool IsNull() const {
+        return NULL != _doc && item().type == YamlDocument::NUL;
+    }
+    /*
+      members are usually in the same order as the document, so start from the one after the last hit.
+      if keys are duplicated the first one wins as YAML::Node, so the cursor is only used for a few
+      pairs with distinct keys, which are checked at the first lookup
+    */
+    YamlEventNode Find(decoder&de, const char*key, const Extend *ext) {
+        (void)ext;
+        const Item &it = item();
+        if (it.type == YamlDocument::NUL) {
+            return YamlEventNode();
+        } else if (it.type != YamlDocument::MAP) {
+            de.decode_exception("not map", NULL);
+        }
+
+        size_t len = strlen(key);
+        size_t first = _index+1;
+        if (_dup < 0) {
+            _dup = this->duplicated(it) ? 1 : 0;
+        }
+        size_t start = (0 == _dup && _cursor > _index && _cursor < it.next) ? _cursor : first;
+        for (size_t k = start; k < it.next;) {
+            size_t v = _doc->At(k).next;
+            if (key_equal(k, key, len)) {
+                _cursor = _doc->At(v).next;
+                return YamlEventNode(_doc, v);
+            }
+            k = _doc->At(v).next;
+            if (k >= it.next) {
+                k = first;
+            }
+            if (k == start) {
+                break;
+            }
+        }
+        return YamlEventNode();
+    }
+    size_t Size(decoder&de) const {
+        if (item().type != YamlDocument::SEQ) {
+            de.decode_exception("not sequence", NULL);
+        }
+        return item().size;
+    }
+    YamlEventNode At(size_t index) const { // no exception, elements are usually accessed in order
+        if (index < _at || _at_index <= _index) {
+            _at = 0;
+            _at_index = _index+1;
+        }
+        for (; _at < index; ++_at) {
+            _at_index = _doc->At(_at_index).next;
+        }
+        return YamlEventNode(_doc, _at_index);
+    }
+    YamlEventNode Next(decoder&de, const YamlEventNode&parent, Iterator&iter, std::string&key) const {
+        const Item &p = parent.item();
+        if (p.type != YamlDocument::MAP) {
+            de.decode_exception("not map", NULL);
+        }
+        if ((void*)this != (void*)(&parent)) {
+            iter = _doc->At(_doc->At(iter).next).next;
+        } else {
+            iter = parent._index+1;
+        }
+        if (iter < p.next) {
+            size_t k = _doc->Resolve(iter);
+            const Item &ki = _doc->At(k);
+            if (ki.type == YamlDocument::SCALAR) {
+                key.assign(_doc->Text(ki), ki.len);
+            } else if (ki.type == YamlDocument::NUL) {
+                key = "null";
+            } else {
+                de.decode_exception(YAML::TypedBadConversion<std::string>(mark(ki)).what(), NULL);
+            }
+            return YamlEventNode(_doc, _doc->At(iter).next);
+        }
+        return YamlEventNode();
+    }
+
+    bool Get(decoder&de, std::string &val, const Extend*ext) {
+        (void)ext;
+        const Item &it = item();
+        if (it.type == YamlDocument::SCALAR) {
+            val.assign(_doc->Text(it), it.len);
+        } else if (it.type == YamlDocument::NUL) {
+            val = "null";
+        } else {
+            de.decode_exception(YAML::TypedBadConversion<std::string>(mark(it)).what(), NULL);
+        }
+        return true;
+    }
+    bool Get(decoder&de, bool &val, const Extend*ext) {
+        (void)ext;
+        static const char *names[][2] = {{"y", "n"}, {"yes", "no"}, {"true", "false"}, {"on", "off"}};
+        const Item &it = item();
+        char low[8];
+        if (it.type == YamlDocument::SCALAR && it.len < sizeof(low) && flexible_case(_doc->Text(it), it.len, low)) {
+            for (size_t i=0; i<sizeof(names)/sizeof(names[0]); ++i) {
+                if (0 == strcmp(low, names[i][0])) {
+                    val = true;
+                    return true;
+                } else if (0 == strcmp(low, names[i][1])) {
+                    val = false;
+                    return true;
+                }
+            }
+        }
+        de.decode_exception(YAML::TypedBadConversion<bool>(mark(it)).what(), NULL);
+        return false;
+    }
     template <class T>
-    bool decode(const std::string&str, T&val) {
-        YAML::Node n = YAML::Load(str);
-        if (n) {
-            YamlNode node(n);
-            return XDecoder<YamlNode>(NULL, (const char*)NULL, node).decode(val, NULL);
+    typename x_enable_if<numeric<T>::value, bool>::type Get(decoder&de, T &val, const Extend*ext){
+        (void)ext;
+        const Item &it = item();
+        if (it.type != YamlDocument::SCALAR || !convert(_doc->Text(it), it.len, val)) {
+            de.decode_exception(YAML::TypedBadConversion<T>(mark(it)).what(), NULL);
+        }
+        return true;
+    }
+
+private:
+    const Item& item() const {
+        return _doc->At(_index);
+    }
+    static YAML::Mark mark(const Item &it) {
+        YAML::Mark m;
+        m.line = it.line;
+        m.column = it.column;
+        return m;
+    }
+    bool duplicated(const Item &it) const {
+        if (it.size > X_PACK_YAML_CURSOR_THRESHOLD) {
+            return true; // too many to check, scan from the first one
+        }
+        for (size_t a = _index+1; a < it.next; a = _doc->At(_doc->At(a).next).next) {
+            const Item &ka = _doc->At(_doc->Resolve(a));
+            if (ka.type != YamlDocument::SCALAR) {
+                continue;
+            }
+            for (size_t b = _doc->At(_doc->At(a).next).next; b < it.next; b = _doc->At(_doc->At(b).next).next) {
+                if (key_equal(b, _doc->Text(ka), ka.len)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+    bool key_equal(size_t index, const char *key, size_t len) const {
+        const Item &k = _doc->At(_doc->Resolve(index));
+        return k.type == YamlDocument::SCALAR && k.len == len && 0 == memcmp(_doc->Text(k), key, len);
+    }
+    // lower, UPPER or Capital, low is the lower case
+    static bool flexible_case(const char *s, size_t len, char *low) {
+        if (0 == len) {
+            return false;
+        }
+        bool upper0 = (s[0] >= 'A' && s[0] <= 'Z');
+        bool allUpper = upper0;
+        bool restLower = true;
+        for (size_t i=0; i<len; ++i) {
+            bool up = (s[i] >= 'A' && s[i] <= 'Z');
+            if (i > 0) {
+                allUpper = allUpper && up;
+                restLower = restLower && !up;
+            }
+            low[i] = up ? (char)(s[i]-'A'+'a') : s[i];
+        }
+        low[len] = '\0';
+        return allUpper || restLower;
+    }
+    static bool space(char c) {
+        return c==' ' || c=='\t' || c=='\n' || c=='\v' || c=='\f' || c=='\r';
+    }
+    static bool tail_space(const char *end, const char *s, size_t len) {
+        for (; end < s+len; ++end) {
+            if (!space(*end)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // same as the stream extraction of yaml-cpp: base is detected by prefix(0x, 0), no leading space, trailing space is ok
+    template <class T>
+    static typename x_enable_if<numeric<T>::is_integer && numeric<T>::is_signed, bool>::type int_convert(const char *s, size_t len, T &val) {
+        if (0 == len || space(s[0])) {
+            return false;
+        }
+        char *end;
+        errno = 0;
+        long long v = strtoll(s, &end, 0);
+        if (end == s || errno == ERANGE || !tail_space(end, s, len)) {
+            return false;
+        }
+        if (v < (long long)std::numeric_limits<T>::min() || v > (long long)std::numeric_limits<T>::max()) {
+            return false;
+        }
+        val = (T)v;
+        return true;
+    }
+    template <class T>
+    static typename x_enable_if<numeric<T>::is_integer && !numeric<T>::is_signed, bool>::type int_convert(const char *s, size_t len, T &val) {
+        if (0 == len || space(s[0]) || s[0] == '-') {
+            return false;
+        }
+        char *end;
+        errno = 0;
+        unsigned long long v = strtoull(s, &end, 0);
+        if (end == s || errno == ERANGE || !tail_space(end, s, len) || v > (unsigned long long)std::numeric_limits<T>::max()) {
+            return false;
+        }
+        val = (T)v;
+        return true;
+    }
+    template <class T>
+    static typename x_enable_if<numeric<T>::is_integer, bool>::type convert(const char *s, size_t len, T &val) {
+        return int_convert(s, len, val);
+    }
+    // char is read as a character
+    static bool convert(const char *s, size_t len, char &val) {
+        if (0 == len || space(s[0]) || !tail_space(s+1, s, len)) {
+            return false;
+        }
+        val = s[0];
+        return true;
+    }
+    template <class T>
+    static typename x_enable_if<numeric<T>::is_float, bool>::type convert(const char *s, size_t len, T &val) {
+        if (0 != len && !space(s[0]) && NULL == strpbrk(s, "xXnNiIpP")) { // no hex, nan, inf
+            char *end;
+            long double v = strtold(s, &end);
+            if (end != s && tail_space(end, s, len)) {
+                if (v > (long double)std::numeric_limits<T>::max() || v < -(long double)std::numeric_limits<T>::max()) {
+                    return false;
+                }
+                val = (T)v;
+                return true;
+            }
+        }
+
+        static const char *infs[] = {".inf", ".Inf", ".INF", "+.inf", "+.Inf", "+.INF"};
+        static const char *ninfs[] = {"-.inf", "-.Inf", "-.INF"};
+        static const char *nans[] = {".nan", ".NaN", ".NAN"};
+        for (size_t i=0; i<sizeof(infs)/sizeof(infs[0]); ++i) {
+            if (0 == strcmp(s, infs[i])) {
+                val = std::numeric_limits<T>::infinity();
+                return true;
+            }
+        }
+        for (size_t i=0; i<sizeof(ninfs)/sizeof(ninfs[0]); ++i) {
+            if (0 == strcmp(s, ninfs[i])) {
+                val = -std::numeric_limits<T>::infinity();
+                return true;
+            }
+        }
+        for (size_t i=0; i<sizeof(nans)/sizeof(nans[0]); ++i) {
+            if (0 == strcmp(s, nans[i])) {
+                val = std::numeric_limits<T>::quiet_NaN();
+                return true;
+            }
         }
         return false;
     }
+
+    const YamlDocument *_doc;
+    size_t _index;
+    size_t _cursor;             // key index after the last hit of Find
+    signed char _dup;           // -1: not checked, 1: duplicated keys or too many pairs, _cursor is not used
+    mutable size_t _at;         // last element of At
+    mutable size_t _at_index;
+};
+
+// read only streambuf over memory, so the parser reads the input without copy
+class YamlMemBuf:public std::streambuf {
+public:
+    YamlMemBuf(const char *data, size_t len) {
+        char *p = const_cast<char*>(data);
+        this->setg(p, p, p+len);
+    }
+};
+
+class YamlDecoder {
+public:
+    template <class T>
+    bool decode(const std::string&str, T&val) {
+        YamlMemBuf buf(str.data(), str.length());
+        std::istream is(&buf);
+        return this->decode(is, val);
+    }
     template <class T>
     bool decode_file(const std::string&fname, T&val) {
-        YAML::Node n = YAML::LoadFile(fname);
+        std::ifstream fs(fname.c_str(), std::ifstream::binary);
+        if (!fs) {
+            throw YAML::BadFile(fname);
+        }
+        return this->decode(fs, val);
+    }
+    // first document of the stream
+    template <class T>
+    bool decode(std::istream &is, T&val) {
+        YAML::Parser parser(is);
+        YamlDocument doc;
+        if (!doc.Load(parser)) {
+            return false;
+        }
+        return this->decode_doc(doc, val);
+    }
+    /*
+      decode the documents("---" separated) of the stream one by one, call f(T&) after each
+      document is decoded. the parser and the document buffer are reused, see decode_each
+      for val. return the number of documents
+    */
+    template <class T, class F>
+    size_t decode_all(std::istream &is, F f) {
+        DocReader reader(is);
+        return decode_each<T>(reader, f);
+    }
+    template <class T, class F>
+    size_t decode_all(const std::string&str, F f) {
+        YamlMemBuf buf(str.data(), str.length());
+        std::istream is(&buf);
+        return this->template decode_all<T>(is, f);
+    }
+    template <class T>
+    bool decode(const YAML::Node&n, T&val) {
         if (n) {
             YamlNode node(n);
             return XDecoder<YamlNode>(NULL, (const char*)NULL, node).decode(val, NULL);
         }
         return false;
     }
-};
+private:
+    class DocReader {
+    public:
+        DocReader(std::istream &is):_parser(is) {}
+        template <class T>
+        bool next(T &val) {
+            if (!_doc.Load(_parser)) {
+                return false;
+            }
+            YamlDecoder::decode_doc(_doc, val);
+            return true;
+        }
+    private:
+        YAML::Parser _parser;
+        YamlDocument _doc;
+    };
 
+    template <class T>
+    static bool decode_doc(const YamlDocument&doc, T&val) {
+        if (doc.Empty()) {
+            return false;
+        }
+        YamlEventNode node(&doc, 0);
+        return XDecoder<YamlEventNode>(NULL, (const char*)NULL, node).decode(val, NULL);
+    }
+};
 
 }
 
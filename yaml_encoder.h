@@ -18,24 +18,37 @@
 #define __X_PACK_YAML_ENCODER_H
 
 #include <string>
-
-#include "yaml-cpp/yaml.h"
+#include <vector>
+#include <string.h>
+#include <float.h>
 
 #include "xencoder.h"
 
 namespace xpack {
 
+/*
+  block style yaml writer, same layout as YAML::Emitter. strings are written plain
+  if the yaml parser reads them back unchanged, otherwise double quoted.
+*/
 class YamlWriter:private noncopyable {
     friend class XEncoder<YamlWriter>;
     friend class YamlEncoder;
 
     const static bool support_null = true;
+
+    struct Level {
+        bool map;
+        size_t col;     // column of keys or '-'
+        size_t count;   // number of entries written
+        Level(bool _map, size_t _col):map(_map), col(_col), count(0) {}
+    };
 public:
-    YamlWriter(size_t indent = 2, int maxDecimalPlaces = -1) {
-        e.SetIndent(indent);
+    YamlWriter(size_t indent = 2, int maxDecimalPlaces = -1):_indent(indent), _line(0), _maxDecimalPlaces(324) {
+        if (_indent < 2) {
+            _indent = 2;
+        }
         if (maxDecimalPlaces > 0) {
-            e.SetFloatPrecision((size_t)maxDecimalPlaces);
-            e.SetDoublePrecision((size_t)maxDecimalPlaces);
+            _maxDecimalPlaces = maxDecimalPlaces;
         }
     }
     ~YamlWriter() {
@@ -49,66 +62,270 @@ private:
         return NULL;
     }
     std::string String() {
-        return std::string(e.c_str(), e.size());
+        return _out;
     }
 
     void ArrayBegin(const char *key, const Extend *ext) {
         (void)ext;
-        xpack_set_key(key);
-        e << YAML::Value << YAML::BeginSeq;
+        this->entry(key);
+        _levels.push_back(Level(false, this->child_col()));
     }
     void ArrayEnd(const char *key, const Extend *ext) {
         (void)key;
         (void)ext;
-        e << YAML::EndSeq;
+        this->end("[]", 2);
     }
     void ObjectBegin(const char *key, const Extend *ext) {
         (void)ext;
-        xpack_set_key(key);
-        e << YAML::Value << YAML::BeginMap;
+        this->entry(key);
+        _levels.push_back(Level(true, this->child_col()));
     }
     void ObjectEnd(const char *key, const Extend *ext) {
         (void)key;
         (void)ext;
-        e << YAML::EndMap;
+        this->end("{}", 2);
     }
     bool WriteNull(const char*key, const Extend *ext) {
         (void)ext;
-        xpack_set_key(key);
-        e << YAML::Value << YAML::Null;
+        this->scalar(key, "~", 1);
         return true;
     }
     bool encode_bool(const char*key, const bool&val, const Extend *ext) {
         (void)ext;
-        xpack_set_key(key);
-        e << YAML::Value << val;
-        return true; 
+        if (val) {
+            this->scalar(key, "true", 4);
+        } else {
+            this->scalar(key, "false", 5);
+        }
+        return true;
     }
     bool encode_string(const char*key, const std::string&val, const Extend *ext) {
         (void)ext;
-        xpack_set_key(key);
         if (!val.empty()) {
-            e << YAML::Value << val;
+            this->entry(key);
+            this->pad();
+            this->string(val.data(), val.length());
         } else {
-            e << YAML::Value << YAML::Null;
+            this->scalar(key, "~", 1);
         }
-        return true; 
+        return true;
+    }
+    // written as character, same as yaml-cpp
+    bool encode_number(const char*key, const char&val, const Extend *ext) {
+        (void)ext;
+        this->character(key, (unsigned char)val);
+        return true;
+    }
+    bool encode_number(const char*key, const unsigned char&val, const Extend *ext) {
+        (void)ext;
+        this->character(key, val);
+        return true;
     }
     template <typename T>
-    typename x_enable_if<numeric<T>::value, bool>::type encode_number(const char*key, const T&val, const Extend *ext) {
+    typename x_enable_if<numeric<T>::is_integer, bool>::type encode_number(const char*key, const T&val, const Extend *ext) {
         (void)ext;
-        xpack_set_key(key);
-        e << YAML::Value << val;
-        return true; 
+        char buf[32];
+        this->scalar(key, buf, Util::itoa(val, buf)-buf);
+        return true;
+    }
+    template <typename T>
+    typename x_enable_if<numeric<T>::is_float, bool>::type encode_number(const char*key, const T&val, const Extend *ext) {
+        (void)ext;
+        double d = (double)val;
+        if (d != d) {
+            this->scalar(key, ".nan", 4);
+        } else if (d > DBL_MAX) {
+            this->scalar(key, ".inf", 4);
+        } else if (d < -DBL_MAX) {
+            this->scalar(key, "-.inf", 5);
+        } else {
+            char buf[64];
+            this->scalar(key, buf, Util::dtoa(d, buf, _maxDecimalPlaces)-buf);
+        }
+        return true;
+    }
+
+    // start an entry of current level, write "key:" or "-"
+    void entry(const char *key) {
+        if (_levels.empty()) {
+            return;
+        }
+        Level &l = _levels.back();
+        if (0 == l.count++) {
+            this->open();
+        } else {
+            this->newline(l.col);
+        }
+        if (l.map) {
+            this->string(key, (NULL==key)?0:strlen(key));
+            _out.push_back(':');
+        } else {
+            _out.push_back('-');
+        }
+    }
+    // the first entry of a level. map in sequence starts at the same line: "- a: 1"
+    void open() {
+        size_t n = _levels.size();
+        if (n == 1) {
+            return;
+        }
+        if (_levels[n-1].map && !_levels[n-2].map) {
+            this->spaces(_levels[n-1].col - this->col());
+        } else {
+            this->newline(_levels[n-1].col);
+        }
+    }
+    void end(const char *empty, size_t len) {
+        size_t n = _levels.size();
+        if (0 == _levels[n-1].count) {
+            if (n > 1) {
+                if (_levels[n-1].map && !_levels[n-2].map) {
+                    this->spaces(_levels[n-1].col - this->col());
+                } else {
+                    this->newline(_levels[n-1].col);
+                }
+            }
+            _out.append(empty, len);
+        }
+        _levels.pop_back();
+    }
+    size_t child_col() const {
+        return _levels.empty() ? 0 : _levels.back().col+_indent;
+    }
+    size_t col() const {
+        return _out.length()-_line;
+    }
+    void newline(size_t col) {
+        _out.push_back('\n');
+        _line = _out.length();
+        this->spaces(col);
+    }
+    void spaces(size_t n) {
+        _out.append(n, ' ');
+    }
+    // space between "key:"/"-" and the scalar value
+    void pad() {
+        if (!_levels.empty()) {
+            size_t c = this->col();
+            size_t to = _levels.back().col+_indent;
+            this->spaces((to > c+1) ? to-c : 1);
+        }
+    }
+    void scalar(const char *key, const char *val, size_t len) {
+        this->entry(key);
+        this->pad();
+        _out.append(val, len);
     }
 
-    void xpack_set_key(const char*key) { // openssl defined set_key macro, so we named it xpack_set_key
-        if (NULL!=key && key[0]!='\0') {
-            e << YAML::Key << key;
+    void character(const char *key, unsigned char c) {
+        this->entry(key);
+        this->pad();
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+            _out.push_back((char)c);
+        } else {
+            _out.push_back('"');
+            if (c >= 0x20 && c < 0x7F && c != '"' && c != '\\') {
+                _out.push_back((char)c);
+            } else {
+                this->escape(c);
+            }
+            _out.push_back('"');
         }
     }
+    void string(const char *s, size_t len) {
+        if (plain(s, len)) {
+            _out.append(s, len);
+            return;
+        }
+
+        _out.push_back('"');
+        size_t i = 0;
+        if (len >= 3 && 0 == memcmp(s, "\xEF\xBB\xBF", 3)) { // BOM
+            _out.append("\\ufeff", 6);
+            i = 3;
+        }
+        for (size_t last = i; ; ++i) {
+            if (i == len) {
+                _out.append(s+last, i-last);
+                break;
+            }
+            unsigned char c = (unsigned char)s[i];
+            if (c < 0x20 || c == 0x7F || c == '"' || c == '\\') {
+                _out.append(s+last, i-last);
+                this->escape(c);
+                last = i+1;
+            }
+        }
+        _out.push_back('"');
+    }
+    void escape(unsigned char c) {
+        static const char hex[] = "0123456789abcdef";
+        _out.push_back('\\');
+        switch (c) {
+          case '"':
+          case '\\':
+            _out.push_back((char)c);
+            break;
+          case '\n':
+            _out.push_back('n');
+            break;
+          case '\t':
+            _out.push_back('t');
+            break;
+          case '\r':
+            _out.push_back('r');
+            break;
+          case '\b':
+            _out.push_back('b');
+            break;
+          default:
+            _out.push_back('x');
+            _out.push_back(hex[c>>4]);
+            _out.push_back(hex[c&0xf]);
+        }
+    }
+    // can be written as plain scalar in block context
+    static bool plain(const char *s, size_t len) {
+        if (0 == len) {
+            return false;
+        }
+        if ((len == 1 && s[0] == '~') || (len == 4 && (0 == memcmp(s, "null", 4) || 0 == memcmp(s, "Null", 4) || 0 == memcmp(s, "NULL", 4)))) {
+            return false;
+        }
+        if (len >= 3 && (0 == memcmp(s, "---", 3) || 0 == memcmp(s, "...", 3) || 0 == memcmp(s, "\xEF\xBB\xBF", 3))) {
+            return false;
+        }
+        switch (s[0]) {
+          case ' ': case ',': case '[': case ']': case '{': case '}': case '#': case '&': case '*':
+          case '!': case '|': case '>': case '\'': case '"': case '%': case '@': case '`':
+            return false;
+          case '-': case '?': case ':':
+            if (len == 1 || s[1] == ' ') {
+                return false;
+            }
+            break;
+        }
+        if (s[len-1] == ' ' || s[len-1] == ':') {
+            return false;
+        }
+        for (size_t i=0; i<len; ++i) {
+            unsigned char c = (unsigned char)s[i];
+            if (c < 0x20 || c == 0x7F) {
+                return false;
+            } else if (c == ':' && s[i+1] == ' ') { // i+1 < len, last one is not ':'
+                return false;
+            } else if (c == '#' && s[i-1] == ' ') { // i > 0, first one is not '#'
+                return false;
+            }
+        }
+        return true;
+    }
 
-    YAML::Emitter e;
+    std::string _out;
+    std::vector<Level> _levels;
+    size_t _indent;
+    size_t _line;           // start of current line in _out
+    int _maxDecimalPlaces;
 };
 
 class YamlEncoder {